@@ -0,0 +1,28 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stdint.h>
+
+/**
+ * Simulator-wide configuration
+ * Filled from the command line in main() and read by the execution engines
+ */
+typedef struct {
+  int gfx_queue_depth; // graphics command queue entries (0 = draw inline)
+  int raster_ppc;      // raster unit fill rate in pixels per cycle
+  int raster_setup;    // fixed setup cycles per drawing primitive
+  int num_cores;       // ASP cores in the pipelined model (1 = single core)
+  int vector_lanes;    // architectural vector length (4 or 8)
+  int depth_bits;      // depth buffer format: 16, 32 or 0 for none
+  int fb_width;        // framebuffer resolution (--resolution WxH)
+  int fb_height;
+  int fb_format;       // PixelFormat of the framebuffer (--format)
+  int fb_layout;       // FbLayout of the framebuffer (--layout)
+  int data_mem_mb;     // data address space in MB (--mem-size)
+  uint32_t mmio_base;  // word address of the MMIO window (--mmio-base)
+  int mul_latency;     // EX cycles of MUL and MAC (--mul-latency)
+} SimConfig;
+
+extern SimConfig sim_config;
+
+#endif // CONFIG_H
@@ -1,16 +1,19 @@
 #ifndef CPU_H
 #define CPU_H
 
+#include "data_memory.h"
 #include <stdint.h>
 #include <stddef.h>
 
 #define MAX_IMEM 65536 // For 32 bit instructions: 65536 * 32 =  2MB RAM
-extern int32_t regs[32];
+extern __thread int32_t regs[32]; // per-core register file (one per thread)
 
 // ---------- Instruction Memory ----------
 typedef struct {
     char **lines;     // dynamic array of instruction text lines
+    uint32_t *code;   // the same instructions encoded; what IF fetches
     size_t size;      // number of instructions
+    DmemImage data;   // initial data memory (.data directives, --data)
 } InstMem;
 
 typedef struct {
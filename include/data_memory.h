@@ -0,0 +1,149 @@
+#ifndef DATA_MEMORY_H
+#define DATA_MEMORY_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Sparse, paged data memory
+ *
+ * The data address space is word-addressed (address = index of a 32-bit
+ * word) and can span several hundred MB. It is reserved as one range of
+ * host virtual memory, but only pages that have been stored to are
+ * resident: a two-level page table maps each 4 KB page (1024 words) to its
+ * frame, and loads from pages that were never written return 0 without
+ * touching the host memory behind them.
+ *
+ * A page's frame sits at that page's own offset in the reserved range, so
+ * any block of the address space is contiguous on the host. BLIT sources
+ * and textures are read from there directly (dmem_block()).
+ *
+ * Cores share one data memory. Faulting a page in is serialized; the
+ * resident-page fast path of dmem_load()/dmem_store() takes no lock.
+ */
+
+#define DMEM_PAGE_SHIFT 10 // 1024 words = 4 KB pages
+#define DMEM_PAGE_WORDS (1u << DMEM_PAGE_SHIFT)
+#define DMEM_PAGE_MASK  (DMEM_PAGE_WORDS - 1)
+#define DMEM_LEAF_SHIFT 10 // 1024 pages (4 MB) per leaf table
+#define DMEM_LEAF_MASK  ((1u << DMEM_LEAF_SHIFT) - 1)
+#define DMEM_DIR_SHIFT  (DMEM_PAGE_SHIFT + DMEM_LEAF_SHIFT)
+
+#define DMEM_DEFAULT_MB 64
+#define DMEM_MAX_MB     1024
+
+// Page table entry: the page's frame, or NULL while not resident
+typedef _Atomic(int32_t *) DmemPte;
+
+typedef struct {
+  int32_t *base;              // reserved address space
+  uint32_t words;             // size of the address space in words
+  uint32_t dir_entries;
+  _Atomic(DmemPte *) *dir;    // level 1: leaf tables, NULL = none resident
+  pthread_mutex_t fault_lock; // serializes dmem_fault()
+  _Atomic uint32_t resident;  // pages resident
+} DataMemory;
+
+/**
+ * @param mb  Size of the address space in MB (1 .. DMEM_MAX_MB)
+ * @return Empty data memory, or NULL if it cannot be reserved
+ */
+DataMemory *dmem_create(uint32_t mb);
+void dmem_destroy(DataMemory *mem);
+
+/**
+ * Slow path of dmem_store(): make the page holding addr resident
+ * @return The page's frame
+ */
+int32_t *dmem_fault(DataMemory *mem, uint32_t addr);
+
+// Frame of the page holding addr, or NULL while not resident
+static inline int32_t *dmem_page(DataMemory *mem, uint32_t addr) {
+  DmemPte *leaf = atomic_load_explicit(&mem->dir[addr >> DMEM_DIR_SHIFT],
+                                       memory_order_acquire);
+  if (!leaf)
+    return NULL;
+  return atomic_load_explicit(&leaf[(addr >> DMEM_PAGE_SHIFT) & DMEM_LEAF_MASK],
+                              memory_order_acquire);
+}
+
+/**
+ * Load the word at addr (0 from pages never stored to)
+ * @return 0, or -1 if addr is outside the address space
+ */
+static inline int dmem_load(DataMemory *mem, uint32_t addr, int32_t *value) {
+  if (addr >= mem->words)
+    return -1;
+  int32_t *page = dmem_page(mem, addr);
+  *value = page ? page[addr & DMEM_PAGE_MASK] : 0;
+  return 0;
+}
+
+/**
+ * Store a word, faulting its page in on first use
+ * @return 0, or -1 if addr is outside the address space
+ */
+static inline int dmem_store(DataMemory *mem, uint32_t addr, int32_t value) {
+  if (addr >= mem->words)
+    return -1;
+  int32_t *page = dmem_page(mem, addr);
+  if (!page)
+    page = dmem_fault(mem, addr);
+  page[addr & DMEM_PAGE_MASK] = value;
+  return 0;
+}
+
+/**
+ * Host view of words [addr, addr + words), for readers of whole blocks
+ * @return Contiguous words, or NULL if the block leaves the address space
+ */
+static inline const int32_t *dmem_block(const DataMemory *mem, uint32_t addr,
+                                        uint64_t words) {
+  return (uint64_t)addr + words <= mem->words ? mem->base + addr : NULL;
+}
+
+// ========== INITIAL CONTENTS ==========
+
+// A block of initial data: words assembled from .data directives, or a
+// binary file (--data) that is mapped in when a run starts
+typedef struct {
+  uint32_t addr;     // first word
+  uint32_t words;
+  int32_t *data;     // assembled words (NULL for a file)
+  uint32_t capacity; // words allocated at data
+  int fd;            // file to map (-1 for assembled words)
+  size_t bytes;      // file size
+} DmemSegment;
+
+// Data memory image of a program; later segments win where they overlap
+typedef struct {
+  DmemSegment *segs;
+  int count, capacity;
+} DmemImage;
+
+/**
+ * Append bytes at word address addr, zero-padded to whole words
+ * @return 0, or -1 if out of host memory
+ */
+int dmem_image_put(DmemImage *img, uint32_t addr, const void *bytes,
+                   size_t size);
+
+/**
+ * Add a binary file to be mapped at word address addr
+ * @return 0, or -1 if the file cannot be opened
+ */
+int dmem_image_file(DmemImage *img, const char *path, uint32_t addr);
+
+void dmem_image_free(DmemImage *img);
+
+/**
+ * Load an image into (fresh) data memory. Files at page-aligned addresses
+ * are mapped copy-on-write, so their pages are read only when touched;
+ * everything else is copied. Loaded pages count as resident.
+ * @return 0, or -1 if a segment does not fit the address space
+ */
+int dmem_image_load(DataMemory *mem, const DmemImage *img);
+
+#endif // DATA_MEMORY_H
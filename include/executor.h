@@ -2,6 +2,7 @@
 #define EXECUTOR_H
 
 #include "isa.h"
+#include "data_memory.h"
 #include "graphics.h"
 #include <stdint.h>
 
@@ -22,6 +23,10 @@ typedef struct {
     int branch_taken;         // 1 if branch was taken
 } ExecResult;
 
+// Identity of the core running on this host thread (read by COREID)
+extern __thread int core_id;
+extern __thread int core_count;
+
 /**
  * Execute a single instruction completely
  * Used by both single-cycle and pipelined models
@@ -34,10 +39,11 @@ typedef struct {
  * @param pc            Current program counter
  * @param rs1_val       Value from rs1 (already read)
  * @param rs2_val       Value from rs2 (already read)
+ * @param rd_val        Value of rd for ops that read it (see reads_rd)
  * @param regs          Register file (32 x 32-bit)
  * @param fb            Framebuffer for graphics ops
- * @param data_mem      Data memory for LW/SW
- * @param data_mem_size Size of data memory
+ * @param mem           Data memory for LW/SW, BLIT and SETTEX
+ *                      (NULL = address only)
  * @return ExecResult   Execution results (ALU output, addresses, etc.)
  */
 ExecResult execute_inst(
@@ -45,13 +51,17 @@ ExecResult execute_inst(
     int rd, int rs1, int rs2,
     int32_t imm,
     uint32_t pc,
-    int32_t rs1_val, int32_t rs2_val,
+    int32_t rs1_val, int32_t rs2_val, int32_t rd_val,
     int32_t *regs,
     Framebuffer *fb,
-    int32_t *data_mem,
-    size_t data_mem_size
+    DataMemory *mem
 );
 
+/**
+ * Cycles an instruction occupies the EX stage (1 for single-cycle units)
+ */
+uint32_t ex_latency(Opcode op, int32_t imm);
+
 /**
  * Write result back to register file
  * Handles invalid register numbers and x0 (always zero)
@@ -0,0 +1,166 @@
+#ifndef GFX_UNIT_H
+#define GFX_UNIT_H
+
+#include "graphics.h"
+#include "isa.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Decoupled graphics coprocessor
+ *
+ * The IO stage posts graphics commands into a bounded queue instead of
+ * drawing inline. A host rasterizer thread drains the queue into the
+ * framebuffer while the simulation thread keeps running.
+ *
+ * Timing is modeled separately from the host thread so cycle counts stay
+ * deterministic: the architectural queue has `depth` entries and the raster
+ * unit retires the command at its head after its raster cost in cycles.
+ *
+ * With depth 0 there is no queue or thread: the IO stage draws inline and
+ * stalls for the full cost of each command.
+ *
+ * Raster cost is a fill-rate model: every drawing primitive pays a fixed
+ * setup cost plus ceil(pixels / pixels-per-cycle); with blending on, each
+ * pixel counts twice (read and write). Textured span pixels take one more
+ * slot for the texel fetch, or two with bilinear filtering. State-only ops
+ * (SETCLR, SETBLEND, SETTEX, TEXU, TEXV, MOVETO, GFXSYNC, PRESENT) take a
+ * single cycle.
+ *
+ * BLIT goes to a separate DMA engine with one transfer in flight. It is
+ * timed at the same fill rate, overlaps with queued raster work, and is
+ * copied on the host in program order with the other commands. The source
+ * block must not be written until DMAPOLL reports completion or DMAWAIT
+ * returns.
+ */
+
+#define GFX_QUEUE_DEFAULT_DEPTH 16
+#define GFX_RING_MIN_CAPACITY 1024
+
+typedef struct {
+  Opcode op;
+  int32_t rs1_val;
+  int32_t rs2_val;
+  int32_t rd_val;
+  int32_t imm;
+  uint32_t mask;       // VDRAWPIX lanes, resolved in EX
+  const int32_t *src;  // BLIT source block in data memory, resolved in IO
+} GfxCommand;
+
+// Host-side lock-free single-producer/single-consumer ring
+typedef struct {
+  GfxCommand *slots;
+  uint32_t mask;         // capacity - 1 (capacity is a power of two)
+  _Atomic uint32_t head; // next slot to fill (simulation thread)
+  _Atomic uint32_t tail; // next slot to drain (rasterizer thread)
+} GfxRing;
+
+// Per-opcode raster statistics for the pipelined run
+typedef struct {
+  uint64_t ops[OP_COUNT];    // commands drawn (rasterizer side)
+  uint64_t pixels[OP_COUNT]; // framebuffer pixels written (rasterizer side)
+  uint64_t cycles[OP_COUNT]; // modeled raster cycles (simulation side)
+} GfxStats;
+
+typedef struct {
+  Framebuffer *fb;
+  GfxRing ring;
+
+  // Rasterizer thread
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  _Atomic int running;
+  _Atomic int sleeping;
+
+  // Architectural model
+  int depth;        // modeled queue entries
+  int q_head;       // index of the command being rasterized
+  int occupancy;    // commands queued or in flight
+  uint32_t busy;    // cycles left on the command at q_head
+  uint32_t *costs;  // per-entry raster cost in cycles
+  int pen_x, pen_y; // draw position as seen by the front end, for costing
+  FbBlendMode blend; // blend mode as seen by the front end, for costing
+  int tex;           // extra fill slots per textured pixel, for costing
+  uint32_t dma_busy; // cycles left on the BLIT in flight
+
+  // Statistics
+  uint64_t commands;    // commands accepted by the queue
+  uint64_t full_stalls; // IO-stage cycles lost to a full queue
+  uint64_t sync_stalls; // IO-stage cycles spent waiting in GFXSYNC
+  uint64_t blits;       // BLITs accepted by the DMA engine
+  uint64_t dma_stalls;  // IO-stage cycles lost to a busy DMA engine
+  uint64_t dma_wait_stalls; // IO-stage cycles spent waiting in DMAWAIT
+  uint64_t mmio_stalls; // IO-stage cycles an MMIO access waited to drain
+  GfxStats stats;       // valid after gfx_unit_drain()
+} GfxUnit;
+
+/**
+ * @param depth  Modeled queue entries; 0 = inline unit without a thread
+ */
+GfxUnit *gfx_unit_create(Framebuffer *fb, int depth);
+void gfx_unit_destroy(GfxUnit *gu);
+
+/**
+ * Advance the modeled raster unit by one cycle
+ * Call once per simulated cycle before the IO stage runs
+ */
+void gfx_unit_tick(GfxUnit *gu);
+
+/**
+ * Post a command from the IO stage
+ * @return 1 if accepted, 0 if the modeled queue is full (IO stage stalls)
+ */
+int gfx_unit_issue(GfxUnit *gu, const GfxCommand *cmd);
+
+/**
+ * Inline unit (depth 0): draw a command immediately
+ * @return Raster cost in cycles, which the IO stage spends stalled
+ */
+uint32_t gfx_unit_draw(GfxUnit *gu, const GfxCommand *cmd);
+
+/**
+ * Start a BLIT on the DMA engine
+ * @return 1 if accepted, 0 while a transfer is in flight (IO stage stalls)
+ */
+int gfx_unit_blit(GfxUnit *gu, const GfxCommand *cmd);
+
+/**
+ * DMAWAIT / DMAPOLL: has the last BLIT completed?
+ * Once it has, the host copy is finished too and the source may be reused
+ * @param wait  Count the cycle as a DMAWAIT stall when still busy
+ */
+int gfx_unit_dma_done(GfxUnit *gu, int wait);
+
+/**
+ * GFXSYNC barrier
+ * @return 1 once every posted command and BLIT has retired, 0 while busy
+ */
+int gfx_unit_sync(GfxUnit *gu);
+
+/**
+ * Barrier in front of an MMIO access (mmio.h): like GFXSYNC, but counted
+ * separately. The front end may touch the framebuffer once it returns 1.
+ */
+int gfx_unit_mmio(GfxUnit *gu);
+
+/**
+ * Cycles still owed by the modeled unit: queued plus in-flight raster work,
+ * or the BLIT in flight if that finishes later
+ */
+uint32_t gfx_unit_pending_cycles(const GfxUnit *gu);
+
+/**
+ * Block the host until the rasterizer thread has drained the ring
+ * Needed before anything on the simulation thread reads the framebuffer
+ */
+void gfx_unit_drain(GfxUnit *gu);
+
+/**
+ * Print per-opcode raster statistics
+ */
+void gfx_stats_print(const GfxStats *stats, FILE *out);
+
+#endif // GFX_UNIT_H
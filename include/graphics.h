@@ -1,34 +1,289 @@
 #ifndef GRAPHICS_H
 #define GRAPHICS_H
 
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdint.h>
 
+// Default resolution; fb_create() takes any size up to FB_MAX_WIDTH x
+// FB_MAX_HEIGHT (4K UHD fits)
 #define FB_WIDTH  256
 #define FB_HEIGHT 256
-#define FB_SIZE   (FB_WIDTH * FB_HEIGHT)
+#define FB_MAX_WIDTH  4096
+#define FB_MAX_HEIGHT 4096
 
+// Colors are always passed around as 32-bit ARGB; the framebuffer stores
+// them in its own pixel format
 typedef uint32_t Pixel;
 
+typedef enum {
+    FB_FORMAT_ARGB8888, // 4 bytes per pixel
+    FB_FORMAT_RGB565,   // 2 bytes per pixel, alpha dropped
+    FB_FORMAT_INDEXED8, // 1 byte per pixel into a 256-entry ARGB palette
+    FB_FORMAT_COUNT
+} PixelFormat;
+
+// Pixel memory layout. Tiled stores 8x8 tiles of 64 consecutive pixels
+// (rows within a tile, tiles in row order), so steep lines and triangle
+// tiles touch a few cache lines instead of one per row. Only the
+// framebuffer internals see the layout; dumps linearize it.
+typedef enum {
+    FB_LAYOUT_LINEAR,
+    FB_LAYOUT_TILED,
+    FB_LAYOUT_COUNT
+} FbLayout;
+
+#define FB_TILE 8
+
+// How drawn pixels combine with the framebuffer (SETBLEND). Blending uses
+// the current color and a constant alpha; the result is always opaque.
+typedef enum {
+    FB_BLEND_NONE,     // overwrite
+    FB_BLEND_OVER,     // source-over: dst + (src - dst) * alpha
+    FB_BLEND_ADD,      // dst + src * alpha, saturating
+    FB_BLEND_MULTIPLY, // dst * src, mixed in by alpha
+    FB_BLEND_COUNT
+} FbBlendMode;
+
+// Texture filtering (SETTEX)
+typedef enum {
+    FB_TEX_NEAREST,  // texel under the sample point
+    FB_TEX_BILINEAR, // weighted 2x2 texels around it
+    FB_TEX_FILTER_COUNT
+} FbTexFilter;
+
+// Texel coordinates are fixed point with FB_TEX_FRAC fraction bits. Texel
+// (i, j) covers [i, i + 1) x [j, j + 1); bilinear filtering treats its
+// center as exact. Coordinates wrap (repeat) in both directions.
+#define FB_TEX_FRAC 8
+#define FB_TEX_MAX  1024 // largest texture side
+
+// Bound texture: width x height 0x00RRGGBB words, rows back to back, with
+// power-of-two sides. Spans map screen pixel (x, y) to texel coordinate
+// u = u0 + x * dudx + y * dudy (v likewise).
+typedef struct {
+    const uint32_t *texels;  // NULL = no texture
+    int width, height;
+    int shift;               // log2(width)
+    FbTexFilter filter;
+    int32_t u0, dudx, dudy;  // TEXU
+    int32_t v0, dvdx, dvdy;  // TEXV
+} FbTexture;
+
+// Dirty tracking granularity: one state byte per 32x32 pixel tile
+#define FB_DIRTY_TILE 32
+#define FB_DIRTY_CHANGED 1 // written since the last PRESENT
+#define FB_DIRTY_INK     2 // may hold non-black pixels (cleared by fb_clear)
+
+// Packed vertex (TRI operands): x in bits 0..15, y in bits 16..31, signed
+#define VERTEX_X(v) ((int)(int16_t)((uint32_t)(v) & 0xFFFF))
+#define VERTEX_Y(v) ((int)(int16_t)((uint32_t)(v) >> 16))
+
+// Triangles with a vertex outside +/-TRI_GUARD_BAND are rejected so that
+// edge functions over the screen fit in 32-bit lanes
+#define TRI_GUARD_BAND 16383
+
+// Receives each completed frame as packed 8-bit RGB rows
+typedef void (*FbFrameSink)(void *ctx, const uint8_t *rgb, int width,
+                            int height);
+
+// Front buffer of a double-buffered framebuffer, shared by its views.
+// PRESENT converts the back buffer tiles changed since the last PRESENT
+// into `rgb`; once every running core has presented the frame, the last
+// one hands it to the sink.
+typedef struct {
+    uint8_t *rgb;            // width * height * 3 bytes, row-major
+    FbFrameSink sink;
+    void *sink_ctx;
+    pthread_mutex_t lock;
+    pthread_cond_t emitted;
+    int cores;               // cores that will present each frame
+    int arrived;             // cores that presented the pending frame
+    uint64_t frames;         // frames emitted
+} FbFront;
+
 typedef struct {
-    Pixel *pixels;
+    void *pixels;            // buffer_pixels entries of bpp bytes each
+    int width, height;
+    PixelFormat format;
+    FbLayout layout;
+    int tiles_x;             // tiles per tile row (FB_LAYOUT_TILED)
+    size_t buffer_pixels;    // width * height, padded to whole tiles
+    int bpp;                 // bytes per pixel
+    Pixel *palette;          // FB_FORMAT_INDEXED8 only, shared by views
     Pixel current_color;
+    uint32_t native_color;   // current_color packed in the pixel format
     int draw_x;
     int draw_y;
+    uint64_t pixels_written; // pixel stores since creation (incl. clears)
+    FbBlendMode blend;       // applies to every draw, not to clears
+    uint8_t blend_alpha;     // 0 = source invisible, 255 = full strength
+    FbTexture tex;           // textures spans and triangles when bound
+
+    // Writable region [clip_x0, clip_x1) x [clip_y0, clip_y1)
+    int clip_x0, clip_y0;
+    int clip_x1, clip_y1;
+    int owns_pixels;         // 0 for views sharing another buffer's pixels
+
+    // Optional depth buffer: depth_bits per pixel, same layout, or NULL.
+    // A pixel is drawn when current_z is nearer (smaller) than its depth.
+    void *depth;
+    int depth_bits;          // 16 or 32
+    uint32_t current_z;      // depth of subsequent primitives (SETZ)
+    int depth_test;          // 1 = spans, triangles and DRAWPIXZ are tested
+
+    // FB_DIRTY_* bits per dirty tile, shared by views. Tiles without INK
+    // are known black, so dumps skip reading them.
+    atomic_uchar *dirty;
+    int dirty_tiles_x, dirty_tiles_y;
+
+    // Double buffering: `pixels` is the back buffer every draw targets
+    FbFront *front;          // NULL until fb_enable_front()
+    uint64_t presented;      // frames this framebuffer or view presented
 } Framebuffer;
 
 Framebuffer* fb_init(void);
+Framebuffer* fb_create(int width, int height, PixelFormat format,
+                       FbLayout layout);
+Framebuffer* fb_view(Framebuffer *parent, int x0, int y0, int x1, int y1);
 void fb_free(Framebuffer *fb);
+int fb_enable_depth(Framebuffer *fb, int bits);
 void fb_clear(Framebuffer *fb);
+void fb_clear_depth(Framebuffer *fb);
+void fb_set_z(Framebuffer *fb, int32_t z, int test);
+void fb_set_pixel_z(Framebuffer *fb, int x, int y, Pixel color);
 void fb_set_pixel(Framebuffer *fb, int x, int y, Pixel color);
 Pixel fb_get_pixel(Framebuffer *fb, int x, int y);
 void fb_set_color(Framebuffer *fb, Pixel color);
+
+/**
+ * Blend mode and constant alpha of subsequent draws (SETBLEND)
+ */
+void fb_set_blend(Framebuffer *fb, FbBlendMode mode, int alpha);
 void fb_draw_pixel(Framebuffer *fb, int x, int y);
 void fb_draw_line(Framebuffer *fb, int x1, int y1, int x2, int y2);
 void fb_draw_step(Framebuffer *fb, int dx, int dy);
+void fb_draw_span_mask(Framebuffer *fb, int x, int y, uint32_t mask);
+uint32_t fb_clip_rect(const Framebuffer *fb, int *x0, int *y0, int *x1,
+                      int *y1);
+/**
+ * Pixels fb_draw_line stores for a line, after clipping
+ */
+uint32_t fb_line_pixels(const Framebuffer *fb, int x1, int y1, int x2,
+                        int y2);
+void fb_fill_span(Framebuffer *fb, int x0, int x1, int y);
+void fb_fill_rect(Framebuffer *fb, int x0, int y0, int x1, int y1);
+void fb_fill_triangle(Framebuffer *fb, int x0, int y0, int x1, int y1, int x2,
+                      int y2);
+
+/**
+ * Copy a w x h block of 0x00RRGGBB words, rows `stride` words apart, to
+ * (x, y) as opaque pixels, clipped to the writable region. With use_key,
+ * source pixels whose RGB equals the current color are transparent.
+ * Blending and depth testing do not apply.
+ * @return Pixels written
+ */
+uint64_t fb_blit(Framebuffer *fb, int x, int y, int w, int h,
+                 const uint32_t *src, int stride, int use_key);
+
+/**
+ * Bind a texture (SETTEX). texels == NULL or a zero side unbinds it. The
+ * mapping set by fb_tex_map() is kept.
+ * @return 0 on success, -1 if a side is not a power of two up to
+ *         FB_TEX_MAX (the texture is then unbound)
+ */
+int fb_tex_bind(FbTexture *tex, const uint32_t *texels, int width,
+                int height, FbTexFilter filter);
+
+/**
+ * Screen-to-texel mapping of one axis (TEXU: axis 0, TEXV: axis 1)
+ */
+void fb_tex_map(FbTexture *tex, int axis, int32_t c0, int32_t dx, int32_t dy);
+
+/**
+ * Sample the bound texture at texel coordinate (u, v) (TEX)
+ * @return 0x00RRGGBB texel, filtered; 0 without a texture
+ */
+uint32_t fb_tex_sample(const FbTexture *tex, int32_t u, int32_t v);
+
+/**
+ * Texture filter by name ("nearest", "bilinear"), or -1
+ */
+int fb_tex_filter_from_name(const char *name);
 void fb_dump_ppm(Framebuffer *fb, const char *filename);
+
+/**
+ * Convert [x0, x1) x [y0, y1) to packed 8-bit RGB rows of (x1 - x0) * 3
+ * bytes, whatever the pixel format and layout
+ */
+void fb_read_rgb(const Framebuffer *fb, int x0, int y0, int x1, int y1,
+                 uint8_t *out);
 void fb_dump_ascii(Framebuffer *fb);
-int fb_in_bounds(int x, int y);
+
+/**
+ * Bounding box [x0, x1) x [y0, y1) of the tiles changed since the last
+ * PRESENT (or during the run, without one), at dirty-tile granularity
+ * @return Number of changed tiles (0 = nothing changed, box untouched)
+ */
+int fb_dirty_bounds(const Framebuffer *fb, int *x0, int *y0, int *x1, int *y1);
+
+/**
+ * Attach a front buffer whose completed frames go to `sink`
+ * @return 0 on success
+ */
+int fb_enable_front(Framebuffer *fb, FbFrameSink sink, void *ctx);
+
+/**
+ * PRESENT: publish this framebuffer's (or view's) region of the back buffer
+ * as the next frame. A view waits until its previous frame has been
+ * emitted, so a core that runs ahead cannot mix two frames. No-op without
+ * a front buffer.
+ */
+void fb_present(Framebuffer *fb);
+
+/**
+ * Number of views that will present each frame (multicore runs)
+ */
+void fb_front_set_cores(Framebuffer *fb, int cores);
+
+/**
+ * A view will present no more frames (its core has halted). Emits the
+ * pending frame if the remaining cores have all presented it.
+ */
+void fb_present_leave(Framebuffer *fb);
+int fb_in_bounds(const Framebuffer *fb, int x, int y);
 Pixel fb_color_rgb(uint8_t r, uint8_t g, uint8_t b);
 Pixel fb_color_argb(uint8_t a, uint8_t r, uint8_t g, uint8_t b);
 
+/**
+ * Convert between ARGB and the framebuffer's pixel format
+ * RGB565 truncates each channel; INDEXED8 picks the nearest palette entry
+ */
+uint32_t fb_pack_color(const Framebuffer *fb, Pixel color);
+Pixel fb_unpack_color(const Framebuffer *fb, uint32_t native);
+
+/**
+ * Replace palette entries [0, count) of an INDEXED8 framebuffer
+ * The default palette is 3-3-2 RGB (index = RRRGGGBB)
+ */
+int fb_set_palette(Framebuffer *fb, const Pixel *colors, int count);
+
+/**
+ * Pixel format by name ("argb8888", "rgb565", "indexed8"), or -1
+ */
+int fb_format_from_name(const char *name);
+const char *fb_format_name(PixelFormat format);
+
+/**
+ * Blend mode by name ("none", "over", "add", "multiply"), or -1
+ */
+int fb_blend_from_name(const char *name);
+
+/**
+ * Memory layout by name ("linear", "tiled"), or -1
+ */
+int fb_layout_from_name(const char *name);
+const char *fb_layout_name(FbLayout layout);
+
 #endif
@@ -0,0 +1,50 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include "graphics.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Still image encoders for framebuffer dumps and frame sequences
+ *
+ * IMAGE_PPM is binary P6. IMAGE_QOI is the "Quite OK Image" format, a
+ * lossless run/index/delta coding that shrinks flat-shaded frames several
+ * times over at little CPU cost. IMAGE_PNG is a plain PNG whose zlib stream
+ * uses stored (uncompressed) deflate blocks: every viewer reads it and
+ * encoding is a copy plus CRC32/Adler-32, but it is no smaller than PPM.
+ */
+
+typedef enum { IMAGE_PPM, IMAGE_QOI, IMAGE_PNG, IMAGE_FORMAT_COUNT } ImageFormat;
+
+/**
+ * Image format by name ("ppm", "qoi", "png"), or -1
+ */
+int image_format_from_name(const char *name);
+
+/**
+ * Image format from a file name's extension; PPM when it has no known one
+ */
+ImageFormat image_format_from_path(const char *path);
+
+/**
+ * Encode packed 8-bit RGB rows into a newly allocated buffer
+ * @return The encoded image (free() it) with its size in *size, or NULL
+ */
+uint8_t *image_encode(ImageFormat format, const uint8_t *rgb, int width,
+                      int height, size_t *size);
+
+/**
+ * Encode packed 8-bit RGB rows and write them to `path` with one write
+ * @return 0 on success
+ */
+int image_write(const char *path, ImageFormat format, const uint8_t *rgb,
+                int width, int height);
+
+/**
+ * Dump the whole framebuffer in the given format
+ * @return 0 on success
+ */
+int image_dump_fb(Framebuffer *fb, const char *path, ImageFormat format);
+
+#endif // IMAGE_H
@@ -2,6 +2,7 @@
 #define ISA_H
 
 #include "cpu.h"
+#include "xform.h"
 #include <stdint.h>
 
 typedef enum {
@@ -23,102 +24,515 @@ typedef enum {
   OP_COS,
   OP_MOVETO,
   OP_LINETO,
+  OP_GFXSYNC,
+  OP_COREID,
+  OP_VSPLAT,
+  OP_VADD,
+  OP_VSUB,
+  OP_VMUL,
+  OP_VMIN,
+  OP_VBLT,
+  OP_VDRAWPIX,
+  OP_HLINE,
+  OP_FILLRECT,
+  OP_TRI,
+  OP_SETZ,
+  OP_DRAWPIXZ,
+  OP_CLEARZ,
+  OP_PRESENT,
+  OP_SETBLEND,
+  OP_BLIT,
+  OP_DMAWAIT,
+  OP_DMAPOLL,
+  OP_SETTEX,
+  OP_TEXU,
+  OP_TEXV,
+  OP_TEX,
   OP_NOP,
+  OP_LUI,
+  OP_ORI,
+  OP_AND,
+  OP_OR,
+  OP_XOR,
+  OP_SLL,
+  OP_SRL,
+  OP_SRA,
+  OP_ANDI,
+  OP_XORI,
+  OP_SLLI,
+  OP_SRLI,
+  OP_SRAI,
+  OP_MAC,
+  OP_DOT,
+  OP_MLOAD,
+  OP_XFORM,
+  OP_SLT,
+  OP_SEQ,
+  OP_CMOV,
+  OP_SEL,
+  OP_MIN,
+  OP_MAX,
   OP_INVALID
 } Opcode;
 
+#define OP_COUNT (OP_INVALID + 1)
+
+// Mnemonic for traces and statistics
+static inline const char *op_name(Opcode op) {
+  static const char *const names[OP_COUNT] = {
+      [OP_ADD] = "ADD",
+      [OP_ADDI] = "ADDI",
+      [OP_SUB] = "SUB",
+      [OP_SUBI] = "SUBI",
+      [OP_MUL] = "MUL",
+      [OP_DIV] = "DIV",
+      [OP_DRAWPIX] = "DRAWPIX",
+      [OP_DRAWSTEP] = "DRAWSTEP",
+      [OP_SETCLR] = "SETCLR",
+      [OP_CLEARFB] = "CLEARFB",
+      [OP_LW] = "LW",
+      [OP_SW] = "SW",
+      [OP_BEQ] = "BEQ",
+      [OP_BLT] = "BLT",
+      [OP_SIN] = "SIN",
+      [OP_COS] = "COS",
+      [OP_MOVETO] = "MOVETO",
+      [OP_LINETO] = "LINETO",
+      [OP_GFXSYNC] = "GFXSYNC",
+      [OP_COREID] = "COREID",
+      [OP_VSPLAT] = "VSPLAT",
+      [OP_VADD] = "VADD",
+      [OP_VSUB] = "VSUB",
+      [OP_VMUL] = "VMUL",
+      [OP_VMIN] = "VMIN",
+      [OP_VBLT] = "VBLT",
+      [OP_VDRAWPIX] = "VDRAWPIX",
+      [OP_HLINE] = "HLINE",
+      [OP_FILLRECT] = "FILLRECT",
+      [OP_TRI] = "TRI",
+      [OP_SETZ] = "SETZ",
+      [OP_DRAWPIXZ] = "DRAWPIXZ",
+      [OP_CLEARZ] = "CLEARZ",
+      [OP_PRESENT] = "PRESENT",
+      [OP_SETBLEND] = "SETBLEND",
+      [OP_BLIT] = "BLIT",
+      [OP_DMAWAIT] = "DMAWAIT",
+      [OP_DMAPOLL] = "DMAPOLL",
+      [OP_SETTEX] = "SETTEX",
+      [OP_TEXU] = "TEXU",
+      [OP_TEXV] = "TEXV",
+      [OP_TEX] = "TEX",
+      [OP_NOP] = "NOP",
+      [OP_LUI] = "LUI",
+      [OP_ORI] = "ORI",
+      [OP_AND] = "AND",
+      [OP_OR] = "OR",
+      [OP_XOR] = "XOR",
+      [OP_SLL] = "SLL",
+      [OP_SRL] = "SRL",
+      [OP_SRA] = "SRA",
+      [OP_ANDI] = "ANDI",
+      [OP_XORI] = "XORI",
+      [OP_SLLI] = "SLLI",
+      [OP_SRLI] = "SRLI",
+      [OP_SRAI] = "SRAI",
+      [OP_MAC] = "MAC",
+      [OP_DOT] = "DOT",
+      [OP_MLOAD] = "MLOAD",
+      [OP_XFORM] = "XFORM",
+      [OP_SLT] = "SLT",
+      [OP_SEQ] = "SEQ",
+      [OP_CMOV] = "CMOV",
+      [OP_SEL] = "SEL",
+      [OP_MIN] = "MIN",
+      [OP_MAX] = "MAX",
+      [OP_INVALID] = "INVALID",
+  };
+  return ((unsigned)op < OP_COUNT && names[op]) ? names[op] : "INVALID";
+}
+
+// Ops handled by the graphics unit in the IO stage
+static inline int is_graphics_op(Opcode op) {
+  switch (op) {
+  case OP_DRAWPIX:
+  case OP_DRAWSTEP:
+  case OP_SETCLR:
+  case OP_CLEARFB:
+  case OP_MOVETO:
+  case OP_LINETO:
+  case OP_GFXSYNC:
+  case OP_VDRAWPIX:
+  case OP_HLINE:
+  case OP_FILLRECT:
+  case OP_TRI:
+  case OP_SETZ:
+  case OP_DRAWPIXZ:
+  case OP_CLEARZ:
+  case OP_PRESENT:
+  case OP_SETBLEND:
+  case OP_BLIT:
+  case OP_DMAWAIT:
+  case OP_DMAPOLL:
+  case OP_SETTEX:
+  case OP_TEXU:
+  case OP_TEXV:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+// Graphics ops that return a value in rd, produced in the IO stage
+static inline int writes_rd_in_io(Opcode op) { return op == OP_DMAPOLL; }
+
+// Ops that read the MEM stage (data memory, the texture unit or the
+// transform unit), so their result can only be forwarded from MEM/WB
+static inline int is_load_op(Opcode op) {
+  return op == OP_LW || op == OP_TEX || op == OP_XFORM;
+}
+
+// Ops that read rd as a third source operand
+static inline int reads_rd(Opcode op) {
+  switch (op) {
+  case OP_HLINE:
+  case OP_TRI:
+  case OP_BLIT:
+  case OP_TEXU:
+  case OP_TEXV:
+  case OP_MAC:
+  case OP_CMOV:
+  case OP_SEL:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+// Conditional selects: each stands in for a branch around a move
+static inline int is_select_op(Opcode op) {
+  switch (op) {
+  case OP_CMOV:
+  case OP_SEL:
+  case OP_MIN:
+  case OP_MAX:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+#define DOT_MAX 3 // components of a DOT
+
+// Consecutive registers read from rs1 (and from rs2): DOT rd, rs1, rs2, n
+// multiplies n-register pairs or triples, and a register-mode XFORM reads
+// a vec4
+static inline int src_span(Opcode op, int32_t imm) {
+  if (op == OP_DOT)
+    return imm;
+  if (op == OP_XFORM && !((imm >> XFORM_MODE_SHIFT) & XFORM_MEM))
+    return XFORM_LANES;
+  return 1;
+}
+
+// Consecutive registers written back from rd: XFORM writes x, y, z, w
+static inline int rd_span(Opcode op) {
+  return op == OP_XFORM ? XFORM_LANES : 1;
+}
+
+// Vector ops whose rs1/rs2 name vector registers
+static inline int has_vector_sources(Opcode op) {
+  switch (op) {
+  case OP_VADD:
+  case OP_VSUB:
+  case OP_VMUL:
+  case OP_VMIN:
+  case OP_VBLT:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+// Vector ops whose rd names a vector register
+static inline int writes_vector_reg(Opcode op) {
+  switch (op) {
+  case OP_VSPLAT:
+  case OP_VADD:
+  case OP_VSUB:
+  case OP_VMUL:
+  case OP_VMIN:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
 typedef struct {
   char name[64];
-  int address;
+  int address; // PC, or word address for labels in a .data section
+  int is_data;
 } LabelEntry;
 
+// Assembler position across both passes: section and .data location
+typedef struct {
+  int in_data;      // 1 after .data, 0 after .text
+  uint32_t loc;     // word address of the next .data word
+  const char *path; // source file, for .incbin paths relative to it
+} AsmState;
+
 // ========== 32-BIT INSTRUCTION ENCODING ==========
-// Format: [opcode(6)] [rd(5)] [rs1(5)] [rs2(5)] [imm(11)]
-// Opcode encoding: 0-13 for valid ops, 14 for invalid
+// The assembler encodes every instruction into one 32-bit word, which is
+// what IF fetches and ID decodes. The opcode sits in the top 7 bits; the
+// rest is laid out by the opcode's format:
+//
+//   R  [op:7][rd:5][rs1:5][rs2:5][imm:10]    registers + small signed imm
+//   I  [op:7][rd:5][rs1:5][imm:15]           signed imm
+//   B  [op:7][imm_hi:5][rs1:5][rs2:5][imm_lo:10]  signed imm (SW, branches)
+//   U  [op:7][rd:5][imm:20]                  unsigned upper imm (LUI)
+//   C  [op:7][imm:25]                        unsigned color (SETCLR)
+//
+// Register fields an opcode does not use are encoded as 0 and decode as -1.
+
+typedef enum { FMT_R, FMT_I, FMT_B, FMT_U, FMT_C } InstFormat;
+
+// Operand fields used by an opcode
+#define USES_RD  1
+#define USES_RS1 2
+#define USES_RS2 4
+#define USES_IMM 8
+
+static inline InstFormat inst_format(Opcode op) {
+  switch (op) {
+  case OP_ADDI:
+  case OP_SUBI:
+  case OP_ORI:
+  case OP_ANDI:
+  case OP_XORI:
+  case OP_SLLI:
+  case OP_SRLI:
+  case OP_SRAI:
+  case OP_LW:
+  case OP_SIN:
+  case OP_COS:
+  case OP_COREID:
+  case OP_VSPLAT:
+  case OP_SETZ:
+  case OP_SETBLEND:
+  case OP_MLOAD:
+  case OP_XFORM:
+    return FMT_I;
+  case OP_SW:
+  case OP_BEQ:
+  case OP_BLT:
+    return FMT_B;
+  case OP_LUI:
+    return FMT_U;
+  case OP_SETCLR:
+    return FMT_C;
+  default:
+    return FMT_R;
+  }
+}
 
-typedef struct {
-  uint32_t encoded;
-  uint32_t pc;
-  int valid;
-} EncodedInst;
+static inline unsigned op_operands(Opcode op) {
+  switch (op) {
+  case OP_ADD:
+  case OP_SUB:
+  case OP_MUL:
+  case OP_DIV:
+  case OP_AND:
+  case OP_OR:
+  case OP_XOR:
+  case OP_SLL:
+  case OP_SRL:
+  case OP_SRA:
+  case OP_MAC:
+  case OP_SLT:
+  case OP_SEQ:
+  case OP_CMOV:
+  case OP_SEL:
+  case OP_MIN:
+  case OP_MAX:
+  case OP_DRAWSTEP:
+  case OP_VADD:
+  case OP_VSUB:
+  case OP_VMUL:
+  case OP_VMIN:
+  case OP_HLINE:
+  case OP_TRI:
+  case OP_TEXU:
+  case OP_TEXV:
+  case OP_TEX:
+    return USES_RD | USES_RS1 | USES_RS2;
+  case OP_ADDI:
+  case OP_SUBI:
+  case OP_ORI:
+  case OP_ANDI:
+  case OP_XORI:
+  case OP_SLLI:
+  case OP_SRLI:
+  case OP_SRAI:
+  case OP_LW:
+  case OP_SIN:
+  case OP_COS:
+  case OP_VSPLAT:
+  case OP_XFORM:
+    return USES_RD | USES_RS1 | USES_IMM;
+  case OP_SW:
+  case OP_BEQ:
+  case OP_BLT:
+  case OP_SETTEX:
+  case OP_VDRAWPIX:
+    return USES_RS1 | USES_RS2 | USES_IMM;
+  case OP_DRAWPIX:
+  case OP_MOVETO:
+  case OP_LINETO:
+  case OP_VBLT:
+  case OP_FILLRECT:
+  case OP_DRAWPIXZ:
+    return USES_RS1 | USES_RS2;
+  case OP_BLIT:
+  case OP_DOT:
+    return USES_RD | USES_RS1 | USES_RS2 | USES_IMM;
+  case OP_COREID:
+  case OP_LUI:
+    return USES_RD | USES_IMM;
+  case OP_SETZ:
+  case OP_MLOAD:
+    return USES_RS1 | USES_IMM;
+  case OP_DMAPOLL:
+    return USES_RD;
+  case OP_SETCLR:
+  case OP_SETBLEND:
+    return USES_IMM;
+  default:
+    return 0; // no operands
+  }
+}
 
-#define OPCODE_SHIFT 26
-#define OPCODE_MASK 0x3F
+#define OPCODE_SHIFT 25
+#define OPCODE_MASK 0x7F
+_Static_assert(OP_COUNT <= OPCODE_MASK + 1, "opcode field is full");
 
-#define RD_SHIFT 21
-#define RS1_SHIFT 16
-#define RS2_SHIFT 11
+#define RD_SHIFT 20
+#define RS1_SHIFT 15
+#define RS2_SHIFT 10
 #define REG_MASK 0x1F
 
-#define IMM_MASK 0x7FF
-#define IMM_SIGN_BIT 0x400
+#define IMM_R_BITS 10
+#define IMM_I_BITS 15
+#define IMM_U_BITS 20
+#define IMM_C_BITS 25
+
+// LUI places its immediate above the 12 bits an ORI fills in
+#define LUI_SHIFT 12
 
 static inline uint32_t encode_instruction(Opcode op, int rd, int rs1, int rs2,
                                           int32_t imm) {
-  uint32_t instr = 0;
-
-  instr |= ((op & OPCODE_MASK) << OPCODE_SHIFT);
-
-  if (rd >= 0)
-    instr |= ((rd & REG_MASK) << RD_SHIFT);
-  if (rs1 >= 0)
-    instr |= ((rs1 & REG_MASK) << RS1_SHIFT);
-  if (rs2 >= 0)
-    instr |= ((rs2 & REG_MASK) << RS2_SHIFT);
-
-  instr |= (imm & IMM_MASK);
-
+  unsigned uses = op_operands(op);
+  uint32_t instr = ((uint32_t)op & OPCODE_MASK) << OPCODE_SHIFT;
+
+  if ((uses & USES_RD) && rd >= 0)
+    instr |= ((uint32_t)rd & REG_MASK) << RD_SHIFT;
+  if ((uses & USES_RS1) && rs1 >= 0)
+    instr |= ((uint32_t)rs1 & REG_MASK) << RS1_SHIFT;
+  if ((uses & USES_RS2) && rs2 >= 0)
+    instr |= ((uint32_t)rs2 & REG_MASK) << RS2_SHIFT;
+  if (!(uses & USES_IMM))
+    return instr;
+
+  uint32_t u = (uint32_t)imm;
+  switch (inst_format(op)) {
+  case FMT_R:
+    return instr | (u & ((1u << IMM_R_BITS) - 1));
+  case FMT_I:
+    return instr | (u & ((1u << IMM_I_BITS) - 1));
+  case FMT_B:
+    return instr | (u & ((1u << IMM_R_BITS) - 1)) |
+           ((u >> IMM_R_BITS) & REG_MASK) << RD_SHIFT;
+  case FMT_U:
+    return instr | (u & ((1u << IMM_U_BITS) - 1));
+  case FMT_C:
+    return instr | (u & ((1u << IMM_C_BITS) - 1));
+  }
   return instr;
 }
 
-// Function to extract opcode from 32-bit instruction
 static inline Opcode decode_opcode(uint32_t instr) {
   return (Opcode)((instr >> OPCODE_SHIFT) & OPCODE_MASK);
 }
 
-// Function to extract rd from 32-bit instruction
+// Register fields, or -1 if the opcode does not use them
 static inline int decode_rd(uint32_t instr) {
-  return (instr >> RD_SHIFT) & REG_MASK;
+  return (op_operands(decode_opcode(instr)) & USES_RD)
+             ? (int)((instr >> RD_SHIFT) & REG_MASK)
+             : -1;
 }
 
-// Function to extract rs1 from 32-bit instruction
 static inline int decode_rs1(uint32_t instr) {
-  return (instr >> RS1_SHIFT) & REG_MASK;
+  return (op_operands(decode_opcode(instr)) & USES_RS1)
+             ? (int)((instr >> RS1_SHIFT) & REG_MASK)
+             : -1;
 }
 
-// Function to extract rs2 from 32-bit instruction
 static inline int decode_rs2(uint32_t instr) {
-  return (instr >> RS2_SHIFT) & REG_MASK;
+  return (op_operands(decode_opcode(instr)) & USES_RS2)
+             ? (int)((instr >> RS2_SHIFT) & REG_MASK)
+             : -1;
+}
+
+// Sign-extend the low `bits` bits of v
+static inline int32_t sign_extend(uint32_t v, int bits) {
+  uint32_t m = 1u << (bits - 1);
+  v &= (1u << bits) - 1;
+  return (int32_t)((v ^ m) - m);
 }
 
-// Function to extract and sign-extend immediate from 32-bit instruction
 static inline int32_t decode_imm(uint32_t instr) {
-  int32_t imm = instr & IMM_MASK;
-  // Sign extend if bit 10 is set
-  if (imm & IMM_SIGN_BIT) {
-    imm |= 0xFFFFF800; // sign extend to 32 bits
+  Opcode op = decode_opcode(instr);
+  if (!(op_operands(op) & USES_IMM))
+    return 0;
+
+  switch (inst_format(op)) {
+  case FMT_R:
+    return sign_extend(instr, IMM_R_BITS);
+  case FMT_I:
+    return sign_extend(instr, IMM_I_BITS);
+  case FMT_B:
+    return sign_extend((instr & ((1u << IMM_R_BITS) - 1)) |
+                           ((instr >> RD_SHIFT) & REG_MASK) << IMM_R_BITS,
+                       IMM_I_BITS);
+  case FMT_U:
+    return (int32_t)(instr & ((1u << IMM_U_BITS) - 1));
+  case FMT_C:
+    return (int32_t)(instr & ((1u << IMM_C_BITS) - 1));
   }
-  return imm;
+  return 0;
 }
 
 // ========== PIPELINE REGISTERS ==========
 
 typedef struct {
-  char *instr_text; // strdup'd text of the instruction
-  uint32_t pc;      // original PC
-  int valid;        // 1 = has instruction, 0 = bubble
+  uint32_t instr; // encoded instruction
+  uint32_t pc;    // original PC
+  int valid;      // 1 = has instruction, 0 = bubble
 } IFIDreg;
 
 typedef struct {
   Opcode op;
   int32_t rs1_val;
   int32_t rs2_val;
+  int32_t rd_val; // value of rd for ops that read it (reads_rd)
   int rs1_idx;
   int rs2_idx;
   int rd;      // destination register number
   int32_t imm; // immediate value
   uint32_t pc; // original PC (for branches)
   int valid;   // 1 = valid, 0 = bubble
+
+  // Multi-cycle EX unit: op started, cycles left before it leaves EX
+  int ex_issued;
+  uint32_t ex_wait;
 } IDEXreg;
 
 typedef struct {
@@ -128,6 +542,8 @@ typedef struct {
   int rd;             // destination register
   int32_t imm;        // immediate value (needed for SETCLR)
   int32_t rs1_val;    // needed for graphics coords
+  int32_t rd_val;     // third source operand (reads_rd ops)
+  int32_t vec[XFORM_LANES]; // XFORM source vector (register mode)
 
   uint32_t pc; // PC for branch prediction/debugging
   int valid;   // 1 = valid, 0 = bubble
@@ -135,6 +551,10 @@ typedef struct {
   // Branch support
   int branch_taken;
   uint32_t target_pc;
+
+  // Inline raster unit: op already drawn, IO stage held for its cost
+  int io_issued;
+  uint32_t io_wait;
 } EXIOreg;
 
 typedef struct {
@@ -142,6 +562,8 @@ typedef struct {
   int32_t alu_result; // result from ALU
   int32_t rs2_val;    // for store operations
   int rd;             // destination register
+  int32_t imm;        // MLOAD/XFORM matrix and mode
+  int32_t vec[XFORM_LANES]; // XFORM source vector (register mode)
   uint32_t pc;        // PC for branch prediction/debugging
   int valid;          // 1 = valid, 0 = bubble
 } IOMEMreg;
@@ -151,6 +573,10 @@ typedef struct {
   int rd;             // destination register
   int is_memory;      // 1 if loading from memory, 0 if ALU result
   int valid;          // 1 = valid, 0 = bubble
+
+  // XFORM: lane[i] is written to rd + i for i < lanes (0 = write_data)
+  int lanes;
+  int32_t lane[XFORM_LANES];
 } MEMWBreg;
 
 // ========== DECODED INSTRUCTION (for legacy support) ==========
@@ -167,12 +593,45 @@ void free_imem(InstMem *im);
 int build_imem(const char *filename, InstMem *im, LabelEntry labels[],
                int label_count);
 
+/**
+ * Handle an assembler directive (.data [addr], .text, .word v, ...,
+ * .incbin "file"). Pass 1 calls it with img = NULL to size data; pass 2
+ * emits the words. Values of .word may name labels.
+ * @return 1 if line was a directive, 0 if not, -1 on error
+ */
+int asm_directive(const char *line, AsmState *st, DmemImage *img,
+                  LabelEntry labels[], int label_count);
+
+#define ASM_PSEUDO_MAX 4 // instructions a pseudo-op expands to, at most
+
+/**
+ * Expand a pseudo-instruction. LI rd, imm32 (number or label) takes one
+ * instruction when it can, two (LUI + ORI) otherwise. MUL/DIV rd, rs1, imm
+ * become shifts when imm is a power of two. Pass 1 calls it with
+ * out = NULL to size it.
+ * @return Instructions written to out, 0 if line is not a pseudo-op, -1 on
+ *         error
+ */
+int asm_pseudo(const char *line, char out[][64], LabelEntry labels[],
+               int label_count);
+
+/**
+ * Decode an encoded instruction
+ * out->valid is 0 for OP_INVALID, which the assembler emits for lines it
+ * could not parse
+ */
+void decode_instruction(uint32_t instr, uint32_t pc, DecodedInst *out);
+
 // Pipeline stages
 void if_stage(ProgramCounter *pc, InstMem *im, IFIDreg *ifid);
 void id_stage(DecodedInst *dec, IDEXreg *idex);
-void ex_stage(IDEXreg *idex, EXIOreg *exio, IOMEMreg *iomem_fwd,
-              MEMWBreg *memwb_fwd);
-void io_stage(EXIOreg *exio, IOMEMreg *iomem);
+// ex_stage stall reasons (0 = none)
+#define EX_STALL_LOAD_USE 1 // operand not ready yet
+#define EX_STALL_BUSY 2     // multi-cycle op still in EX
+
+int ex_stage(IDEXreg *idex, EXIOreg *exio, IOMEMreg *iomem_fwd,
+             MEMWBreg *memwb_fwd); // returns an EX_STALL_* reason
+int io_stage(EXIOreg *exio, IOMEMreg *iomem); // returns 1 on stall
 void mem_stage(IOMEMreg *iomem, MEMWBreg *memwb);
 void wb_stage(MEMWBreg *memwb);
 
@@ -0,0 +1,51 @@
+#ifndef MMIO_H
+#define MMIO_H
+
+#include "config.h"
+#include "graphics.h"
+#include <stdint.h>
+
+/**
+ * Memory-mapped framebuffer and I/O registers
+ *
+ * A window of the word address space, outside data memory, that LW and SW
+ * reach when an address misses data memory. Word (y * width + x) from
+ * the window base is pixel (x, y) as 0x00RRGGBB, whatever the pixel
+ * format and layout. The control registers follow the largest possible
+ * frame. Pixel stores are raw: no blending, depth test or texture, but
+ * clipped to the core's band like any draw.
+ *
+ * Accesses see the framebuffer as the front end does, so the pipeline
+ * drains the core's graphics unit before an access goes through.
+ */
+
+#define MMIO_DEFAULT_BASE 0x40000000u // past the largest data memory
+#define MMIO_REGS (FB_MAX_WIDTH * FB_MAX_HEIGHT) // offset of the registers
+
+// Control registers, in words from MMIO_REGS
+typedef enum {
+  MMIO_REG_COLOR,  // r/w: current color, as set by SETCLR
+  MMIO_REG_POS,    // r/w: draw position (y << 16) | x, as set by MOVETO
+  MMIO_REG_SIZE,   // r:   (height << 16) | width
+  MMIO_REG_FORMAT, // r:   PixelFormat of the framebuffer
+  MMIO_REG_COUNT
+} MmioReg;
+
+#define MMIO_WINDOW_WORDS (MMIO_REGS + MMIO_REG_COUNT)
+
+// Whether addr falls in the MMIO window (--mmio-base)
+static inline int mmio_hit(uint32_t addr) {
+  return addr - sim_config.mmio_base < MMIO_WINDOW_WORDS;
+}
+
+/**
+ * @return 0, or -1 if addr is not a readable word of the window
+ */
+int mmio_load(Framebuffer *fb, uint32_t addr, int32_t *value);
+
+/**
+ * @return 0, or -1 if addr is not a writable word of the window
+ */
+int mmio_store(Framebuffer *fb, uint32_t addr, int32_t value);
+
+#endif // MMIO_H
@@ -8,7 +8,9 @@
 // ---------- Function Prototypes ----------
 
 int parse_register(const char *tok);
-void instruction_parser(IFIDreg *ifid, DecodedInst *out);
+int parse_vregister(const char *tok);
+int parse_mregister(const char *tok);
+void instruction_parser(const char *text, uint32_t pc, DecodedInst *out);
 int ctoi(const char *c);
 void trim_inplace(char* s);
 int32_t parse_immediate(const char* token);
@@ -0,0 +1,34 @@
+#ifndef TRIG_H
+#define TRIG_H
+
+#include <stdint.h>
+
+/**
+ * Fixed-point trigonometry unit for SIN/COS
+ *
+ * The instruction immediate selects the format:
+ *   TRIG_LEGACY  angle in degrees, result scaled by 100 (original format)
+ *   TRIG_Q15     angle in binary angle units (65536 = one turn), Q15 result
+ *                from an interpolated lookup table; single cycle
+ *   TRIG_CORDIC  angle in binary angle units, Q16 result from an iterative
+ *                CORDIC unit; one EX cycle per iteration
+ *
+ * No libm calls at run time: tables are built once by trig_init().
+ */
+
+#define TRIG_LEGACY 0
+#define TRIG_Q15 1
+#define TRIG_CORDIC 2
+
+#define TRIG_CORDIC_ITERATIONS 18
+
+void trig_init(void);
+int32_t trig_sin(int32_t angle, int mode);
+int32_t trig_cos(int32_t angle, int mode);
+
+/**
+ * EX-stage latency of SIN/COS in a given mode, in cycles
+ */
+uint32_t trig_latency(int mode);
+
+#endif // TRIG_H
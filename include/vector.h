@@ -0,0 +1,45 @@
+#ifndef VECTOR_H
+#define VECTOR_H
+
+#include <stdint.h>
+
+/**
+ * Vector (SIMD) unit
+ *
+ * 16 vector registers v0..v15 of up to 8 x 32-bit lanes plus one lane mask.
+ * The architectural lane count is 4 or 8 (--vlen); host kernels always
+ * compute all 8 lanes and use SSE2/SSE4.1/AVX2 intrinsics when available.
+ *
+ * Vector registers and the mask are read and written in EX, so in-order
+ * issue is enough to keep them coherent in the pipelined model.
+ */
+
+#define VREG_COUNT 16
+#define VLEN_MAX 8
+
+typedef struct {
+  int32_t lane[VLEN_MAX];
+} __attribute__((aligned(32))) VReg;
+
+// Per-core vector state (one per simulation thread)
+extern __thread VReg vregs[VREG_COUNT];
+extern __thread uint32_t vmask; // bit i = lane i selected
+
+// VDRAWPIX lane selection (immediate operand)
+#define VDRAW_MASK 0     // lanes set in the mask
+#define VDRAW_INVERTED 1 // lanes clear in the mask
+#define VDRAW_ALL 2      // every lane
+
+void vec_splat(VReg *d, int32_t base, int32_t stride);
+void vec_add(VReg *d, const VReg *a, const VReg *b);
+void vec_sub(VReg *d, const VReg *a, const VReg *b);
+void vec_mul(VReg *d, const VReg *a, const VReg *b);
+void vec_min(VReg *d, const VReg *a, const VReg *b);
+uint32_t vec_lt_mask(const VReg *a, const VReg *b); // bit i = a[i] < b[i]
+
+/**
+ * Lanes VDRAWPIX should draw for a selection mode, limited to `lanes`
+ */
+uint32_t vec_draw_mask(uint32_t mask, int mode, int lanes);
+
+#endif // VECTOR_H
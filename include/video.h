@@ -0,0 +1,69 @@
+#ifndef VIDEO_H
+#define VIDEO_H
+
+#include "image.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Video stream output for PRESENTed frames
+ *
+ * VIDEO_Y4M writes a YUV4MPEG2 stream (4:2:0, BT.601 limited range) that
+ * encoders such as ffmpeg read directly from a pipe. VIDEO_RAW writes bare
+ * 8-bit RGB frames (rawvideo rgb24); the size and rate are not stored.
+ *
+ * VIDEO_PPM, VIDEO_QOI and VIDEO_PNG write an image sequence instead: one
+ * file per frame, named from a pattern ("frame%04d.qoi"). A pattern without
+ * a %d gets a five-digit frame number before its extension.
+ */
+
+typedef enum {
+  VIDEO_Y4M,
+  VIDEO_RAW,
+  VIDEO_PPM,
+  VIDEO_QOI,
+  VIDEO_PNG,
+  VIDEO_FORMAT_COUNT
+} VideoFormat;
+
+typedef struct {
+  FILE *out;     // stream formats
+  char *pattern; // image sequences
+  VideoFormat format;
+  int width, height;
+  int fps;
+  uint64_t frames;
+  uint8_t *yuv; // Y4M frame scratch (planar Y, U, V)
+  int failed;   // a write failed (e.g. the pipe closed); later frames drop
+} VideoStream;
+
+/**
+ * Start a stream on an open file; the stream does not close it
+ */
+VideoStream *video_open(FILE *out, VideoFormat format, int width, int height,
+                        int fps);
+
+/**
+ * Start an image sequence (VIDEO_PPM, VIDEO_QOI or VIDEO_PNG)
+ */
+VideoStream *video_open_sequence(const char *pattern, VideoFormat format,
+                                 int width, int height);
+
+/**
+ * 1 if the format writes one file per frame rather than a stream
+ */
+int video_is_sequence(VideoFormat format);
+
+/**
+ * Append one frame of packed 8-bit RGB rows (an FbFrameSink)
+ */
+void video_frame(void *stream, const uint8_t *rgb, int width, int height);
+
+void video_close(VideoStream *vs);
+
+/**
+ * Stream format by name ("y4m", "rgb", "ppm", "qoi", "png"), or -1
+ */
+int video_format_from_name(const char *name);
+
+#endif // VIDEO_H
@@ -0,0 +1,64 @@
+#ifndef XFORM_H
+#define XFORM_H
+
+#include "data_memory.h"
+#include <stdint.h>
+
+/**
+ * Fixed-point 4x4 transform unit for MLOAD/XFORM
+ *
+ * Four matrix registers m0..m3 hold 16 Q16.16 words each, row-major, and
+ * are loaded from data memory with MLOAD. XFORM multiplies a vec4 (four
+ * consecutive registers, or four words of data memory) by one of them and
+ * writes x, y, z, w to four consecutive registers. With XFORM_PERSP set,
+ * x, y and z are then divided by w.
+ *
+ * The unit sits beside the MEM stage: MLOAD and XFORM read their operands
+ * there, in program order, so in-order issue keeps the matrix registers
+ * coherent. Its latency is charged in EX.
+ */
+
+#define MREG_COUNT 4
+#define XFORM_LANES 4
+#define XFORM_FRAC_BITS 16 // matrix entries are Q16.16
+
+// XFORM immediate: matrix register in the low bits, mode above them
+#define XFORM_MREG_MASK (MREG_COUNT - 1)
+#define XFORM_MODE_SHIFT 2
+#define XFORM_PERSP 1 // divide x, y, z by w
+#define XFORM_MEM 2   // read the vector from data memory at rs1
+
+#define XFORM_CYCLES 4 // one matrix row per cycle
+#define MLOAD_CYCLES 4 // 16 words, four per cycle
+
+typedef struct {
+  int32_t m[XFORM_LANES][XFORM_LANES];
+} Mat4;
+
+// Per-core matrix registers (one set per simulation thread)
+extern __thread Mat4 mregs[MREG_COUNT];
+
+/**
+ * Load matrix register m from 16 words at addr
+ * @return 0, or -1 if the words leave data memory
+ */
+int xform_mload(DataMemory *mem, uint32_t addr, int m);
+
+/**
+ * Read the vec4 of a memory-mode XFORM
+ * @return 0, or -1 if the words leave data memory
+ */
+int xform_fetch(DataMemory *mem, uint32_t addr, int32_t v[XFORM_LANES]);
+
+/**
+ * Transform v by the matrix and mode in an XFORM immediate
+ */
+void xform_apply(int32_t imm, const int32_t v[XFORM_LANES],
+                 int32_t out[XFORM_LANES]);
+
+/**
+ * EX-stage latency of XFORM for an immediate, in cycles
+ */
+uint32_t xform_latency(int32_t imm);
+
+#endif // XFORM_H
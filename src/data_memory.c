@@ -0,0 +1,209 @@
+#include "../include/data_memory.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+DataMemory *dmem_create(uint32_t mb) {
+  if (mb < 1 || mb > DMEM_MAX_MB)
+    return NULL;
+
+  DataMemory *mem = (DataMemory *)calloc(1, sizeof(DataMemory));
+  if (!mem)
+    return NULL;
+
+  // Address space only: the host commits a frame when its page is stored to
+  size_t bytes = (size_t)mb << 20;
+  void *base = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (base == MAP_FAILED) {
+    free(mem);
+    return NULL;
+  }
+
+  mem->base = (int32_t *)base;
+  mem->words = (uint32_t)(bytes / sizeof(int32_t));
+  mem->dir_entries = ((mem->words - 1) >> DMEM_DIR_SHIFT) + 1;
+  mem->dir = (_Atomic(DmemPte *) *)calloc(mem->dir_entries,
+                                          sizeof(*mem->dir));
+  if (!mem->dir) {
+    munmap(base, bytes);
+    free(mem);
+    return NULL;
+  }
+  pthread_mutex_init(&mem->fault_lock, NULL);
+  atomic_init(&mem->resident, 0);
+  return mem;
+}
+
+void dmem_destroy(DataMemory *mem) {
+  if (!mem)
+    return;
+  for (uint32_t i = 0; i < mem->dir_entries; i++)
+    free((void *)atomic_load(&mem->dir[i]));
+  free(mem->dir);
+  pthread_mutex_destroy(&mem->fault_lock);
+  munmap(mem->base, (size_t)mem->words * sizeof(int32_t));
+  free(mem);
+}
+
+int32_t *dmem_fault(DataMemory *mem, uint32_t addr) {
+  pthread_mutex_lock(&mem->fault_lock);
+
+  // Another core may have faulted the page in since the caller looked
+  _Atomic(DmemPte *) *slot = &mem->dir[addr >> DMEM_DIR_SHIFT];
+  DmemPte *leaf = atomic_load(slot);
+  if (!leaf) {
+    leaf = (DmemPte *)calloc(DMEM_LEAF_MASK + 1, sizeof(DmemPte));
+    if (!leaf) {
+      fprintf(stderr, "Out of memory for the data page table\n");
+      abort();
+    }
+    atomic_store_explicit(slot, leaf, memory_order_release);
+  }
+
+  DmemPte *pte = &leaf[(addr >> DMEM_PAGE_SHIFT) & DMEM_LEAF_MASK];
+  int32_t *frame = atomic_load(pte);
+  if (!frame) {
+    frame = mem->base + (addr & ~DMEM_PAGE_MASK);
+    atomic_store_explicit(pte, frame, memory_order_release);
+    atomic_fetch_add(&mem->resident, 1);
+  }
+
+  pthread_mutex_unlock(&mem->fault_lock);
+  return frame;
+}
+
+// ========== INITIAL CONTENTS ==========
+
+static DmemSegment *image_append(DmemImage *img, uint32_t addr) {
+  if (img->count == img->capacity) {
+    int cap = img->capacity ? img->capacity * 2 : 8;
+    DmemSegment *segs =
+        (DmemSegment *)realloc(img->segs, cap * sizeof(DmemSegment));
+    if (!segs)
+      return NULL;
+    img->segs = segs;
+    img->capacity = cap;
+  }
+  DmemSegment *seg = &img->segs[img->count++];
+  memset(seg, 0, sizeof(*seg));
+  seg->addr = addr;
+  seg->fd = -1;
+  return seg;
+}
+
+int dmem_image_put(DmemImage *img, uint32_t addr, const void *bytes,
+                   size_t size) {
+  uint32_t words = (uint32_t)((size + sizeof(int32_t) - 1) / sizeof(int32_t));
+  if (words == 0)
+    return 0;
+
+  // Consecutive directives grow one segment
+  DmemSegment *seg = img->count ? &img->segs[img->count - 1] : NULL;
+  if (!seg || seg->fd >= 0 || seg->addr + seg->words != addr)
+    seg = image_append(img, addr);
+  if (!seg)
+    return -1;
+
+  if (seg->words + words > seg->capacity) {
+    uint32_t cap = seg->capacity ? seg->capacity : 64;
+    while (cap < seg->words + words)
+      cap *= 2;
+    int32_t *data = (int32_t *)realloc(seg->data, cap * sizeof(int32_t));
+    if (!data)
+      return -1;
+    seg->data = data;
+    seg->capacity = cap;
+  }
+
+  seg->data[seg->words + words - 1] = 0; // padding of a partial last word
+  memcpy(seg->data + seg->words, bytes, size);
+  seg->words += words;
+  return 0;
+}
+
+int dmem_image_file(DmemImage *img, const char *path, uint32_t addr) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+
+  struct stat st;
+  DmemSegment *seg = NULL;
+  if (fstat(fd, &st) != 0 || !(seg = image_append(img, addr))) {
+    close(fd);
+    return -1;
+  }
+  seg->fd = fd;
+  seg->bytes = (size_t)st.st_size;
+  seg->words = (uint32_t)((seg->bytes + sizeof(int32_t) - 1) /
+                          sizeof(int32_t));
+  return 0;
+}
+
+void dmem_image_free(DmemImage *img) {
+  for (int i = 0; i < img->count; i++) {
+    free(img->segs[i].data);
+    if (img->segs[i].fd >= 0)
+      close(img->segs[i].fd);
+  }
+  free(img->segs);
+  memset(img, 0, sizeof(*img));
+}
+
+// Enter the pages of [addr, addr + words) in the page table
+static void make_resident(DataMemory *mem, uint32_t addr, uint32_t words) {
+  uint64_t end = (uint64_t)addr + words;
+  for (uint64_t a = addr & ~DMEM_PAGE_MASK; a < end; a += DMEM_PAGE_WORDS)
+    if (!dmem_page(mem, (uint32_t)a))
+      dmem_fault(mem, (uint32_t)a);
+}
+
+// Map a file over its part of the reservation, or copy it in when the
+// address is not page-aligned
+static int load_file(DataMemory *mem, const DmemSegment *seg) {
+  int32_t *dst = mem->base + seg->addr;
+  if (seg->bytes == 0)
+    return 0;
+
+  if ((seg->addr & DMEM_PAGE_MASK) == 0 &&
+      sysconf(_SC_PAGESIZE) == DMEM_PAGE_WORDS * sizeof(int32_t)) {
+    void *p = mmap(dst, seg->bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_FIXED, seg->fd, 0);
+    return p == MAP_FAILED ? -1 : 0;
+  }
+
+  void *src = mmap(NULL, seg->bytes, PROT_READ, MAP_PRIVATE, seg->fd, 0);
+  if (src == MAP_FAILED)
+    return -1;
+  memcpy(dst, src, seg->bytes);
+  munmap(src, seg->bytes);
+  return 0;
+}
+
+int dmem_image_load(DataMemory *mem, const DmemImage *img) {
+  for (int i = 0; i < img->count; i++) {
+    const DmemSegment *seg = &img->segs[i];
+    if (!dmem_block(mem, seg->addr, seg->words)) {
+      fprintf(stderr,
+              "Data at 0x%x (%u words) does not fit the data memory\n",
+              seg->addr, seg->words);
+      return -1;
+    }
+
+    if (seg->fd >= 0) {
+      if (load_file(mem, seg) != 0) {
+        perror("mmap");
+        return -1;
+      }
+    } else {
+      memcpy(mem->base + seg->addr, seg->data,
+             (size_t)seg->words * sizeof(int32_t));
+    }
+    make_resident(mem, seg->addr, seg->words);
+  }
+  return 0;
+}
@@ -1,4 +1,17 @@
+#include "../include/executor.h"
 #include "../include/isa.h"
+#include <string.h>
+
+void decode_instruction(uint32_t instr, uint32_t pc, DecodedInst *out) {
+  memset(out, 0, sizeof(DecodedInst));
+  out->op = decode_opcode(instr);
+  out->rd = decode_rd(instr);
+  out->rs1 = decode_rs1(instr);
+  out->rs2 = decode_rs2(instr);
+  out->imm = decode_imm(instr);
+  out->pc = pc;
+  out->valid = out->op < OP_INVALID;
+}
 
 void id_stage(DecodedInst *dec, IDEXreg *idex) {
   if (!dec->valid) {
@@ -11,8 +24,9 @@ void id_stage(DecodedInst *dec, IDEXreg *idex) {
   idex->op = dec->op;
 
   // Read operand values from register file
-  idex->rs1_val = regs[dec->rs1];
-  idex->rs2_val = regs[dec->rs2];
+  idex->rs1_val = read_register(regs, dec->rs1);
+  idex->rs2_val = read_register(regs, dec->rs2);
+  idex->rd_val = reads_rd(dec->op) ? read_register(regs, dec->rd) : 0;
 
   idex->rs1_idx = dec->rs1;
   idex->rs2_idx = dec->rs2;
@@ -20,4 +34,6 @@ void id_stage(DecodedInst *dec, IDEXreg *idex) {
   idex->rd = dec->rd;
   idex->imm = dec->imm;
   idex->pc = dec->pc;
+  idex->ex_issued = 0;
+  idex->ex_wait = 0;
 }
@@ -1,105 +1,241 @@
 #include "../include/executor.h"
+#include "../include/gfx_unit.h"
 #include "../include/graphics.h"
 #include "../include/isa.h"
+#include "../include/mmio.h"
+#include "../include/xform.h"
 #include <stdio.h>
 #include <string.h>
 
-// External global framebuffer
-Framebuffer *global_fb = NULL;
+// Framebuffer seen by this core (a view of the shared one on multicore runs)
+__thread Framebuffer *global_fb = NULL;
 
-// Simple data memory (simulated)
-#define DATA_MEM_SIZE 4096
-static int32_t data_memory[DATA_MEM_SIZE];
+// This core's graphics unit (NULL = draw inline without cost modeling)
+__thread GfxUnit *global_gfx = NULL;
+
+// Texture binding seen by TEX on this core: set in IO in program order with
+// the graphics unit's copy, sampled in MEM
+__thread FbTexture global_tex;
+
+// Data memory of the running model, shared by all cores
+DataMemory *data_memory = NULL;
 
 // ========== EXECUTE STAGE ==========
-void ex_stage(IDEXreg *idex, EXIOreg *exio, IOMEMreg *iomem_fwd,
-              MEMWBreg *memwb_fwd) {
+
+// Operand value seen by EX: register file (already holds everything that
+// has passed WB) overridden by the IO/MEM and MEM/WB forwarding paths.
+// Priority: IOMEM (youngest/most recent) > MEMWB (older)
+static int32_t forward_operand(int idx, IOMEMreg *iomem_fwd,
+                               MEMWBreg *memwb_fwd) {
+  if (idx <= 0) // Don't forward r0
+    return read_register(regs, idx);
+
+  if (iomem_fwd->valid && iomem_fwd->rd == idx)
+    return iomem_fwd->alu_result;
+  if (memwb_fwd->valid && memwb_fwd->lanes && idx >= memwb_fwd->rd &&
+      idx < memwb_fwd->rd + memwb_fwd->lanes)
+    return memwb_fwd->lane[idx - memwb_fwd->rd];
+  if (memwb_fwd->valid && memwb_fwd->rd == idx)
+    return memwb_fwd->write_data;
+  return read_register(regs, idx);
+}
+
+// Whether the op in ID/EX reads scalar register r in EX, including the
+// register pairs, triples and vec4s of DOT and XFORM (src_span)
+static int ex_reads(const IDEXreg *idex, int r) {
+  int span = src_span(idex->op, idex->imm);
+  int rs1 = has_vector_sources(idex->op) ? -1 : idex->rs1_idx;
+  int rs2 = has_vector_sources(idex->op) ? -1 : idex->rs2_idx;
+  return (rs1 >= 0 && r >= rs1 && r < rs1 + span) ||
+         (rs2 >= 0 && r >= rs2 && r < rs2 + span) ||
+         (reads_rd(idex->op) && r == idex->rd);
+}
+
+int ex_stage(IDEXreg *idex, EXIOreg *exio, IOMEMreg *iomem_fwd,
+             MEMWBreg *memwb_fwd) {
   // Initialize output as bubble
   exio->valid = 0;
 
   if (!idex->valid) {
-    return; // Pass through bubble
+    return 0; // Pass through bubble
   }
 
-  exio->valid = 1;
-  exio->op = idex->op;
-  exio->rd = idex->rd;
-  exio->pc = idex->pc;
-
-  // Initial values from ID (RegFile read)
-  int32_t current_rs1_val = idex->rs1_val;
-  int32_t current_rs2_val = idex->rs2_val;
+  // Vector sources live in the vector file, which EX reads directly
+  int scalar_rs1 = has_vector_sources(idex->op) ? -1 : idex->rs1_idx;
+  int scalar_rs2 = has_vector_sources(idex->op) ? -1 : idex->rs2_idx;
+  int scalar_rd = reads_rd(idex->op) ? idex->rd : -1;
+  int span = src_span(idex->op, idex->imm);
 
-  // --- FORWARDING LOGIC ---
-  // Priority: IOMEM (youngest/most recent) > MEMWB (older)
-
-  // Forwarding for RS1
-  if (idex->rs1_idx != 0) { // Don't forward r0
-    if (iomem_fwd->valid && iomem_fwd->rd != 0 &&
-        iomem_fwd->rd == idex->rs1_idx) {
-      current_rs1_val = iomem_fwd->alu_result;
-    } else if (memwb_fwd->valid && memwb_fwd->rd != 0 &&
-               memwb_fwd->rd == idex->rs1_idx) {
-      current_rs1_val = memwb_fwd->write_data;
+  // --- LOAD-USE HAZARD ---
+  // A load one stage ahead has not read memory yet: hold ID/EX one cycle
+  // until its data can be forwarded from MEM/WB.
+  if (iomem_fwd->valid && is_load_op(iomem_fwd->op)) {
+    for (int i = 0; i < rd_span(iomem_fwd->op); i++) {
+      int r = iomem_fwd->rd + i;
+      if (r > 0 && ex_reads(idex, r))
+        return EX_STALL_LOAD_USE;
     }
   }
 
-  // Forwarding for RS2
-  if (idex->rs2_idx != 0) {
-    if (iomem_fwd->valid && iomem_fwd->rd != 0 &&
-        iomem_fwd->rd == idex->rs2_idx) {
-      current_rs2_val = iomem_fwd->alu_result;
-    } else if (memwb_fwd->valid && memwb_fwd->rd != 0 &&
-               memwb_fwd->rd == idex->rs2_idx) {
-      current_rs2_val = memwb_fwd->write_data;
-    }
+  // --- MULTI-CYCLE UNITS ---
+  // Hold the op in EX for its latency; it computes on its last cycle, so
+  // operands are forwarded as of then.
+  if (!idex->ex_issued) {
+    idex->ex_issued = 1;
+    idex->ex_wait = ex_latency(idex->op, idex->imm) - 1;
+  }
+  if (idex->ex_wait > 0) {
+    idex->ex_wait--;
+    return EX_STALL_BUSY;
   }
 
+  exio->valid = 1;
+  exio->op = idex->op;
+  exio->rd = writes_vector_reg(idex->op) ? -1 : idex->rd; // vd is not in x*
+  exio->pc = idex->pc;
+
+  // --- FORWARDING LOGIC ---
+  int32_t current_rs1_val = forward_operand(scalar_rs1, iomem_fwd, memwb_fwd);
+  int32_t current_rs2_val = forward_operand(scalar_rs2, iomem_fwd, memwb_fwd);
+  int32_t current_rd_val = forward_operand(scalar_rd, iomem_fwd, memwb_fwd);
+
   exio->rs1_val = current_rs1_val;
   exio->rs2_val = current_rs2_val;
+  exio->rd_val = current_rd_val;
   exio->imm = idex->imm;
 
-  // Use unified executor with NULL framebuffer
-  // Graphics ops will be effectively NOPs here but valid ops
+  // Use unified executor with NULL framebuffer and NULL data memory:
+  // graphics ops are handled in IO, loads/stores only compute their
+  // address here, and the register file is only written in WB.
+  int32_t scratch_regs[32];
+  for (int i = 1; i < span; i++) {
+    scratch_regs[scalar_rs1 + i] =
+        forward_operand(scalar_rs1 + i, iomem_fwd, memwb_fwd);
+    if (scalar_rs2 >= 0)
+      scratch_regs[scalar_rs2 + i] =
+          forward_operand(scalar_rs2 + i, iomem_fwd, memwb_fwd);
+  }
+  if (idex->op == OP_XFORM) {
+    // Register mode: the vec4 goes to the transform unit beside MEM
+    exio->vec[0] = current_rs1_val;
+    for (int i = 1; i < span; i++)
+      exio->vec[i] = scratch_regs[scalar_rs1 + i];
+  }
   ExecResult exec_result = execute_inst(
-      idex->op, idex->rd, -1, -1, // Registers already read in ID stage
-      idex->imm, idex->pc, current_rs1_val, current_rs2_val,
-      regs, // Global register file
+      idex->op, idex->rd, idex->rs1_idx, idex->rs2_idx, // for vector ops
+      idex->imm, idex->pc, current_rs1_val, current_rs2_val, current_rd_val,
+      scratch_regs,
       NULL, // NO FRAMEBUFFER IN EX STAGE
-      data_memory, DATA_MEM_SIZE);
+      NULL);
 
   exio->alu_result = exec_result.alu_result;
   exio->branch_taken = (exec_result.is_branch && exec_result.branch_taken);
   exio->target_pc = exec_result.next_pc;
+  exio->io_issued = 0;
+  exio->io_wait = 0;
+  return 0;
 }
 
 // ========== I/O STAGE ==========
-void io_stage(EXIOreg *exio, IOMEMreg *iomem) {
+int io_stage(EXIOreg *exio, IOMEMreg *iomem) {
   // Initialize output as bubble
   iomem->valid = 0;
 
   if (!exio->valid) {
-    return;
+    return 0;
+  }
+
+  // MMIO loads and stores see the framebuffer as of program order: hold
+  // them here until this core's graphics unit has caught up
+  if ((exio->op == OP_LW || exio->op == OP_SW) && global_gfx &&
+      mmio_hit(exio->alu_result) && !gfx_unit_mmio(global_gfx))
+    return 1;
+
+  // Execute only graphics instructions
+  if (is_graphics_op(exio->op)) {
+    GfxCommand cmd = {.op = exio->op,
+                      .rs1_val = exio->rs1_val,
+                      .rs2_val = exio->rs2_val,
+                      .rd_val = exio->rd_val,
+                      .imm = exio->imm,
+                      .mask = (uint32_t)exio->alu_result}; // VDRAWPIX lanes
+
+    if (exio->op == OP_SETTEX) {
+      // Resolve the texture now; the raster unit and TEX read it later
+      uint32_t addr = exio->rs1_val;
+      int w = exio->rs2_val & 0xFFFF, h = (uint32_t)exio->rs2_val >> 16;
+      cmd.src = dmem_block(data_memory, addr, (uint64_t)w * h);
+      if (fb_tex_bind(&global_tex, (const uint32_t *)cmd.src, w, h,
+                      (FbTexFilter)exio->imm) != 0)
+        cmd.src = NULL;
+      if (global_gfx && !cmd.src && w && h)
+        printf("SETTEX: no %dx%d texture at address 0x%x\n", w, h, addr);
+    } else if (exio->op == OP_TEXU || exio->op == OP_TEXV) {
+      fb_tex_map(&global_tex, exio->op == OP_TEXV, exio->rs1_val,
+                 exio->rs2_val, exio->rd_val);
+    }
+
+    if (exio->op == OP_BLIT && global_gfx) {
+      // Resolve the source block now; the DMA engine reads it later
+      uint32_t addr = exio->rs1_val;
+      uint64_t words = (uint64_t)(exio->rd_val & 0xFFFF) *
+                       ((uint32_t)exio->rd_val >> 16);
+      cmd.src = dmem_block(data_memory, addr, words);
+      if (cmd.src) {
+        if (!gfx_unit_blit(global_gfx, &cmd))
+          return 1;
+      } else {
+        printf("Memory access violation: BLIT at address 0x%x\n", addr);
+      }
+    } else if ((exio->op == OP_DMAWAIT || exio->op == OP_DMAPOLL) &&
+               global_gfx) {
+      int done = gfx_unit_dma_done(global_gfx, exio->op == OP_DMAWAIT);
+      if (exio->op == OP_DMAWAIT && !done)
+        return 1;
+      exio->alu_result = done;
+    } else if (!global_gfx) {
+      // Queries write back through WB like everything else
+      int32_t scratch_regs[32];
+      ExecResult res = execute_inst(exio->op, exio->rd, -1, -1, exio->imm,
+                                    exio->pc, exio->rs1_val, exio->rs2_val,
+                                    exio->rd_val, scratch_regs,
+                                    global_fb, // ACCESS FRAMEBUFFER HERE
+                                    data_memory);
+      if (writes_rd_in_io(exio->op))
+        exio->alu_result = res.alu_result;
+    } else if (global_gfx->depth == 0) {
+      // Inline raster unit: draw now, then hold the IO stage for the cost
+      if (!exio->io_issued) {
+        exio->io_issued = 1;
+        exio->io_wait = gfx_unit_draw(global_gfx, &cmd) - 1;
+      }
+      if (exio->io_wait > 0) {
+        exio->io_wait--;
+        return 1;
+      }
+    } else if (exio->op == OP_GFXSYNC) {
+      // Coprocessor barrier: hold EX/IO until the queue has drained
+      if (!gfx_unit_sync(global_gfx))
+        return 1;
+    } else {
+      // Hand off to the coprocessor; hold EX/IO while it cannot accept
+      if (!gfx_unit_issue(global_gfx, &cmd))
+        return 1;
+    }
   }
 
   iomem->valid = 1;
   iomem->op = exio->op;
-  iomem->rd = exio->rd;
+  // Graphics ops do not write back, except queries answered here
+  iomem->rd = is_graphics_op(exio->op) && !writes_rd_in_io(exio->op)
+                  ? -1
+                  : exio->rd;
   iomem->pc = exio->pc;
   iomem->rs2_val = exio->rs2_val;
   iomem->alu_result = exio->alu_result;
-
-  // Execute only graphics instructions
-  if (exio->op == OP_DRAWPIX || exio->op == OP_DRAWSTEP ||
-      exio->op == OP_SETCLR || exio->op == OP_CLEARFB ||
-      exio->op == OP_MOVETO || exio->op == OP_LINETO) {
-
-    execute_inst(exio->op, exio->rd, -1, -1, exio->imm, exio->pc, exio->rs1_val,
-                 exio->rs2_val, regs,
-                 global_fb,   // ACCESS FRAMEBUFFER HERE
-                 data_memory, // Should not touch memory but passed anyway
-                 DATA_MEM_SIZE);
-  }
+  iomem->imm = exio->imm;
+  memcpy(iomem->vec, exio->vec, sizeof(iomem->vec));
+  return 0;
 }
 
 // ========== MEMORY STAGE ==========
@@ -115,14 +251,15 @@ void mem_stage(IOMEMreg *iomem, MEMWBreg *memwb) {
   memwb->rd = iomem->rd;
   memwb->is_memory = 0; // Default: ALU result
   memwb->write_data = iomem->alu_result;
+  memwb->lanes = 0;
 
   // Handle memory operations
   switch (iomem->op) {
   case OP_LW: {
     // Load from memory
     uint32_t addr = iomem->alu_result;
-    if (addr < DATA_MEM_SIZE) {
-      memwb->write_data = data_memory[addr];
+    if (dmem_load(data_memory, addr, &memwb->write_data) == 0 ||
+        mmio_load(global_fb, addr, &memwb->write_data) == 0) {
       memwb->is_memory = 1;
     } else {
       printf("Memory access violation: LW at address 0x%x\n", addr);
@@ -130,32 +267,66 @@ void mem_stage(IOMEMreg *iomem, MEMWBreg *memwb) {
     break;
   }
 
+  case OP_TEX:
+    // Texture fetch: u computed in EX, v carried in rs2_val
+    memwb->write_data = (int32_t)fb_tex_sample(&global_tex, iomem->alu_result,
+                                               iomem->rs2_val);
+    memwb->is_memory = 1;
+    break;
+
+  case OP_MLOAD:
+    // Matrix load: address computed in EX
+    if (xform_mload(data_memory, iomem->alu_result, iomem->imm) != 0)
+      printf("Memory access violation: MLOAD at address 0x%x\n",
+             iomem->alu_result);
+    memwb->rd = -1;
+    break;
+
+  case OP_XFORM: {
+    // Transform unit: the vec4 came from EX, or is read here
+    int32_t v[XFORM_LANES];
+    memcpy(v, iomem->vec, sizeof(v));
+    if (((iomem->imm >> XFORM_MODE_SHIFT) & XFORM_MEM) &&
+        xform_fetch(data_memory, iomem->alu_result, v) != 0) {
+      printf("Memory access violation: XFORM at address 0x%x\n",
+             iomem->alu_result);
+      memwb->rd = -1;
+      break;
+    }
+    xform_apply(iomem->imm, v, memwb->lane);
+    memwb->lanes = XFORM_LANES;
+    memwb->write_data = memwb->lane[0];
+    memwb->is_memory = 1;
+    break;
+  }
+
   case OP_SW: {
     // Store to memory
     uint32_t addr = iomem->alu_result;
-    if (addr < DATA_MEM_SIZE) {
-      data_memory[addr] = iomem->rs2_val;
+    if (dmem_store(data_memory, addr, iomem->rs2_val) == 0) {
       memwb->valid = 1;
       memwb->rd = -1; // No writeback register for store
+    } else if (mmio_store(global_fb, addr, iomem->rs2_val) == 0) {
+      memwb->rd = -1;
+      if (global_gfx) {
+        // The store may have moved the pen behind the unit's back
+        global_gfx->pen_x = global_fb->draw_x;
+        global_gfx->pen_y = global_fb->draw_y;
+      }
     } else {
       printf("Memory access violation: SW at address 0x%x\n", addr);
     }
     break;
   }
 
-  // Graphics operations don't need memory stage
-  case OP_DRAWPIX:
-  case OP_DRAWSTEP:
-  case OP_SETCLR:
-  case OP_CLEARFB:
-  case OP_MOVETO:
-  case OP_LINETO:
-    memwb->rd = -1; // No register writeback
-    break;
-
   default:
-    // All other operations: ALU result is passed through
-    memwb->write_data = iomem->alu_result;
+    if (is_graphics_op(iomem->op) && !writes_rd_in_io(iomem->op)) {
+      // Graphics operations don't need memory stage
+      memwb->rd = -1; // No register writeback
+    } else {
+      // All other operations: ALU result is passed through
+      memwb->write_data = iomem->alu_result;
+    }
     break;
   }
 }
@@ -166,8 +337,20 @@ void wb_stage(MEMWBreg *memwb) {
     return; // Bubble: nothing to write back
   }
 
-  // Write back to register file
-  if (memwb->rd >= 0 && memwb->rd < 32) {
+  // XFORM writes a register per lane
+  if (memwb->lanes) {
+    for (int i = 0; i < memwb->lanes; i++) {
+      int rd = memwb->rd + i;
+      if (rd > 0 && rd < 32) {
+        regs[rd] = memwb->lane[i];
+        printf("WB: Wrote 0x%x to register x%d\n", memwb->lane[i], rd);
+      }
+    }
+    return;
+  }
+
+  // Write back to register file (x0 stays zero)
+  if (memwb->rd > 0 && memwb->rd < 32) {
     regs[memwb->rd] = memwb->write_data;
     printf("WB: Wrote 0x%x to register x%d\n", memwb->write_data, memwb->rd);
   }
@@ -1,18 +1,42 @@
 #include "../include/execution.h"
+#include "../include/config.h"
 #include "../include/executor.h"
+#include "../include/gfx_unit.h"
 #include "../include/parse_instruction.h"
+#include "../include/vector.h"
+#include "../include/xform.h"
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-
-#define DATA_MEM_SIZE 4096
-static int32_t data_memory[DATA_MEM_SIZE];
+#include <time.h>
+
+extern DataMemory *data_memory;
+extern __thread Framebuffer *global_fb;
+extern __thread GfxUnit *global_gfx;
+extern __thread FbTexture global_tex;
+
+// A taken branch resolves in EX and squashes the two instructions behind it
+#define BRANCH_FLUSH_CYCLES 2
+
+// Whether a select's condition picked the moved value, i.e. whether the
+// branch around the move it replaces would have been taken
+static int select_moved(const EXIOreg *ex) {
+  switch (ex->op) {
+  case OP_CMOV:
+    return ex->rs2_val != 0;
+  case OP_SEL:
+    return ex->rd_val != 0;
+  default: // MIN, MAX: the second operand won
+    return ex->alu_result != ex->rs1_val;
+  }
+}
 
 // ============================================================================
 // TRACING UTILITIES
 // ============================================================================
 
-static FILE *trace_file = NULL;
+static __thread FILE *trace_file = NULL; // one trace per core
 
 static void open_trace(const char *filename) {
   if (!trace_file && filename)
@@ -88,6 +112,11 @@ execute_single_cycle(InstMem *im, LabelEntry labels[] __attribute__((unused)),
 
   int32_t regs[32];
   memset(regs, 0, sizeof(regs));
+  memset(vregs, 0, sizeof(vregs));
+  vmask = 0;
+  memset(mregs, 0, sizeof(mregs));
+  if (fb) // texture bindings point into this model's data memory
+    fb_tex_bind(&fb->tex, NULL, 0, 0, FB_TEX_NEAREST);
 
   uint32_t pc = 0;
   uint32_t cycle = 0;
@@ -98,16 +127,9 @@ execute_single_cycle(InstMem *im, LabelEntry labels[] __attribute__((unused)),
   while (pc < im->size) {
     printf("Cycle %u: PC=%u\n", cycle, pc);
 
-    // Parse instruction
+    // Decode instruction
     DecodedInst decoded;
-    memset(&decoded, 0, sizeof(decoded));
-
-    IFIDreg temp_ifid;
-    temp_ifid.instr_text = im->lines[pc];
-    temp_ifid.pc = pc;
-    temp_ifid.valid = 1;
-
-    instruction_parser(&temp_ifid, &decoded);
+    decode_instruction(im->code[pc], pc, &decoded);
 
     if (decoded.valid) {
       printf("  Instr: %s\n", im->lines[pc]);
@@ -118,10 +140,11 @@ execute_single_cycle(InstMem *im, LabelEntry labels[] __attribute__((unused)),
       // Execute instruction (Unified Handling)
       int32_t rs1_val = read_register(regs, decoded.rs1);
       int32_t rs2_val = read_register(regs, decoded.rs2);
+      int32_t rd_val = reads_rd(decoded.op) ? read_register(regs, decoded.rd) : 0;
 
-      ExecResult res = execute_inst(
-          decoded.op, decoded.rd, decoded.rs1, decoded.rs2, decoded.imm, pc,
-          rs1_val, rs2_val, regs, fb, data_memory, DATA_MEM_SIZE);
+      ExecResult res = execute_inst(decoded.op, decoded.rd, decoded.rs1,
+                                    decoded.rs2, decoded.imm, pc, rs1_val,
+                                    rs2_val, rd_val, regs, fb, data_memory);
 
       // Update PC based on result
       if (res.is_branch && res.branch_taken) {
@@ -179,8 +202,21 @@ execute_pipelined(InstMem *im, LabelEntry labels[] __attribute__((unused)),
   if (!result)
     return NULL;
 
-  int32_t regs[32];
+  // This core's register files
   memset(regs, 0, sizeof(regs));
+  memset(vregs, 0, sizeof(vregs));
+  vmask = 0;
+  memset(mregs, 0, sizeof(mregs));
+
+  // Texture bindings point into this model's data memory
+  memset(&global_tex, 0, sizeof(global_tex));
+  fb_tex_bind(&fb->tex, NULL, 0, 0, FB_TEX_NEAREST);
+
+  // Graphics coprocessor: IO stage posts commands to a rasterizer thread
+  global_fb = fb;
+  global_gfx = gfx_unit_create(fb, sim_config.gfx_queue_depth);
+  if (!global_gfx)
+    fprintf(stderr, "Graphics unit unavailable; drawing without cost model\n");
 
   // Initialize pipeline registers
   IFIDreg ifid;
@@ -203,15 +239,50 @@ execute_pipelined(InstMem *im, LabelEntry labels[] __attribute__((unused)),
   printf("Starting pipeline simulation...\n\n");
 
   int idle = 0;
+  uint32_t io_stalls = 0;
+  uint32_t load_stalls = 0;
+  uint32_t ex_busy = 0;
+  uint32_t branch_flushes = 0;
+  uint32_t selects = 0;       // conditional selects executed
+  uint32_t selects_moved = 0; // ... that stood in for a taken branch
   while (idle < 6 && cycle < 1000000) {
+    gfx_unit_tick(global_gfx);
+
     // Execute stages in reverse order (so latest results propagate)
     wb_stage(&memwb);
     mem_stage(&iomem, &memwb);
-    io_stage(&exio, &iomem);
+
+    // --- PIPELINE CONTROL: IO STALL ---
+    // Graphics unit cannot accept the op yet: hold EX/IO and everything
+    // younger, and send a bubble down to MEM.
+    if (io_stage(&exio, &iomem)) {
+      io_stalls++;
+      trace_pipeline_state(cycle, &ifid, &idex, &exio, &iomem, &memwb);
+      trace_reg_file(cycle, pc.pc, regs);
+      cycle++;
+      continue;
+    }
 
     // Use unified executor in EX stage
     // Note: Logic inside ex_stage is now handling the execution
-    ex_stage(&idex, &exio, &iomem, &memwb);
+    // --- PIPELINE CONTROL: LOAD-USE / MULTI-CYCLE STALL ---
+    // EX sent a bubble; hold ID/EX and IF/ID for one cycle.
+    int ex_stall = ex_stage(&idex, &exio, &iomem, &memwb);
+    if (ex_stall) {
+      if (ex_stall == EX_STALL_BUSY)
+        ex_busy++;
+      else
+        load_stalls++;
+      trace_pipeline_state(cycle, &ifid, &idex, &exio, &iomem, &memwb);
+      trace_reg_file(cycle, pc.pc, regs);
+      cycle++;
+      continue;
+    }
+
+    if (exio.valid && is_select_op(exio.op)) {
+      selects++;
+      selects_moved += select_moved(&exio);
+    }
 
     // --- PIPELINE CONTROL: BRANCH FLUSH ---
     // If a branch was taken in EX stage, we must flush IF/ID and ID/EX
@@ -219,6 +290,7 @@ execute_pipelined(InstMem *im, LabelEntry labels[] __attribute__((unused)),
     if (exio.valid && exio.branch_taken) {
       printf("[Branch] Taken at PC=%u -> Target=%u. Flushing pipeline.\n",
              exio.pc, exio.target_pc);
+      branch_flushes++;
 
       // Update PC
       pc.pc = exio.target_pc;
@@ -234,7 +306,8 @@ execute_pipelined(InstMem *im, LabelEntry labels[] __attribute__((unused)),
     // Decode and ID stage
     DecodedInst decoded;
     memset(&decoded, 0, sizeof(decoded));
-    instruction_parser(&ifid, &decoded);
+    if (ifid.valid)
+      decode_instruction(ifid.instr, ifid.pc, &decoded);
     id_stage(&decoded, &idex);
 
     // Fetch stage
@@ -253,16 +326,45 @@ execute_pipelined(InstMem *im, LabelEntry labels[] __attribute__((unused)),
     cycle++;
   }
 
+  // Program end acts as an implicit GFXSYNC: the frame is not done until
+  // the raster unit has retired every queued command.
+  uint32_t gfx_drain = gfx_unit_pending_cycles(global_gfx);
+  cycle += gfx_drain;
+
   result->cycle_count = cycle;
   result->total_instructions = im->size;
   result->mode = EXEC_MODE_PIPELINED;
   memcpy(result->final_regs, regs, sizeof(regs));
 
-  printf("\n=== PIPELINED RESULTS ===\n");
+  if (core_count > 1)
+    printf("\n=== PIPELINED RESULTS (core %d) ===\n", core_id);
+  else
+    printf("\n=== PIPELINED RESULTS ===\n");
   printf("Total cycles: %u\n", cycle);
   printf("Total instructions: %lu\n", im->size);
   double cpi = (im->size > 0) ? (double)cycle / im->size : 0;
-  printf("CPI (Cycles Per Instruction): %.2f\n\n", cpi);
+  printf("CPI (Cycles Per Instruction): %.2f\n", cpi);
+  printf("IO stall cycles: %u\n", io_stalls);
+  printf("Load-use stall cycles: %u\n", load_stalls);
+  printf("Multi-cycle EX stall cycles: %u\n", ex_busy);
+  printf("Branch flushes: %u (%u cycles)\n", branch_flushes,
+         branch_flushes * BRANCH_FLUSH_CYCLES);
+  if (selects > 0)
+    printf("Conditional selects: %u, %u in place of a taken branch "
+           "(%u flush cycles avoided)\n",
+           selects, selects_moved, selects_moved * BRANCH_FLUSH_CYCLES);
+  if (global_gfx && global_gfx->depth > 0) {
+    printf("Graphics queue: depth %d, %lu commands, %lu full-queue stalls, "
+           "%lu GFXSYNC stalls, %lu MMIO stalls, %u drain cycles\n",
+           global_gfx->depth, global_gfx->commands, global_gfx->full_stalls,
+           global_gfx->sync_stalls, global_gfx->mmio_stalls, gfx_drain);
+  }
+  if (global_gfx && global_gfx->blits > 0) {
+    printf("DMA engine: %lu BLITs, %lu busy stalls, %lu DMAWAIT stalls\n",
+           global_gfx->blits, global_gfx->dma_stalls,
+           global_gfx->dma_wait_stalls);
+  }
+  printf("\n");
 
   if (trace_file) {
     fprintf(trace_file, "\n=== SIMULATION SUMMARY ===\n");
@@ -270,6 +372,32 @@ execute_pipelined(InstMem *im, LabelEntry labels[] __attribute__((unused)),
     fprintf(trace_file, "Total Cycles: %u\n", cycle);
     fprintf(trace_file, "Total Instructions: %lu\n", im->size);
     fprintf(trace_file, "CPI: %.2f\n", cpi);
+    fprintf(trace_file, "IO Stall Cycles: %u\n", io_stalls);
+    fprintf(trace_file, "Load-Use Stall Cycles: %u\n", load_stalls);
+    fprintf(trace_file, "Multi-Cycle EX Stall Cycles: %u\n", ex_busy);
+    if (global_gfx && global_gfx->depth > 0) {
+      fprintf(trace_file, "GFX Commands: %lu\n", global_gfx->commands);
+      fprintf(trace_file, "GFX Full-Queue Stalls: %lu\n",
+              global_gfx->full_stalls);
+      fprintf(trace_file, "GFX Sync Stalls: %lu\n", global_gfx->sync_stalls);
+    }
+    if (global_gfx && global_gfx->blits > 0) {
+      fprintf(trace_file, "DMA BLITs: %lu\n", global_gfx->blits);
+      fprintf(trace_file, "DMA Busy Stalls: %lu\n", global_gfx->dma_stalls);
+      fprintf(trace_file, "DMA Wait Stalls: %lu\n",
+              global_gfx->dma_wait_stalls);
+    }
+  }
+
+  // Rasterizer thread finishes the queue before the framebuffer is dumped
+  // (and before its pixel counts are read)
+  if (global_gfx) {
+    gfx_unit_drain(global_gfx);
+    gfx_stats_print(&global_gfx->stats, stdout);
+    if (trace_file)
+      gfx_stats_print(&global_gfx->stats, trace_file);
+    gfx_unit_destroy(global_gfx);
+    global_gfx = NULL;
   }
 
   free_ifid(&ifid);
@@ -277,6 +405,130 @@ execute_pipelined(InstMem *im, LabelEntry labels[] __attribute__((unused)),
   return result;
 }
 
+// ============================================================================
+// MULTICORE EXECUTION MODE
+// ============================================================================
+
+typedef struct {
+  int id;
+  InstMem *im;
+  LabelEntry *labels;
+  int label_count;
+  Framebuffer *view; // this core's tile of the shared framebuffer
+  char trace_name[256];
+  ExecutionResult *result;
+} CoreTask;
+
+static void *core_main(void *arg) {
+  CoreTask *task = (CoreTask *)arg;
+
+  core_id = task->id;
+  core_count = sim_config.num_cores;
+  open_trace(task->trace_name[0] ? task->trace_name : NULL);
+  task->result =
+      execute_pipelined(task->im, task->labels, task->label_count, task->view);
+  fb_present_leave(task->view); // halted: stop holding up later frames
+  close_trace();
+  return NULL;
+}
+
+// Core 0 traces to `base`; core N to "<stem>_coreN<ext>"
+static void core_trace_name(char *out, size_t n, const char *base, int id) {
+  if (!base) {
+    out[0] = '\0';
+    return;
+  }
+  if (id == 0) {
+    snprintf(out, n, "%s", base);
+    return;
+  }
+  const char *dot = strrchr(base, '.');
+  int stem = dot ? (int)(dot - base) : (int)strlen(base);
+  snprintf(out, n, "%.*s_core%d%s", stem, base, id, dot ? dot : "");
+}
+
+// Each core runs its own pipeline on a host thread. Cores share data memory
+// and the framebuffer; the screen is split into horizontal bands and each
+// core may only write pixels inside its own band (tile ownership), so pixel
+// stores never race.
+static ExecutionResult *execute_multicore(InstMem *im, LabelEntry labels[],
+                                          int label_count, Framebuffer *fb,
+                                          const char *trace_filename) {
+  int n = sim_config.num_cores;
+  CoreTask *tasks = (CoreTask *)calloc(n, sizeof(CoreTask));
+  pthread_t *threads = (pthread_t *)calloc(n, sizeof(pthread_t));
+  ExecutionResult *result = (ExecutionResult *)malloc(sizeof(ExecutionResult));
+  if (!tasks || !threads || !result) {
+    free(tasks);
+    free(threads);
+    free(result);
+    return NULL;
+  }
+
+  printf("\n=== MULTICORE EXECUTION: %d cores ===\n", n);
+
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+
+  // Every core presents its own band of each frame
+  fb_front_set_cores(fb, n);
+
+  int started = 0;
+  for (int i = 0; i < n; i++) {
+    CoreTask *t = &tasks[i];
+    t->id = i;
+    t->im = im;
+    t->labels = labels;
+    t->label_count = label_count;
+    t->view = fb_view(fb, 0, i * fb->height / n, fb->width,
+                      (i + 1) * fb->height / n);
+    core_trace_name(t->trace_name, sizeof(t->trace_name), trace_filename, i);
+    if (!t->view || pthread_create(&threads[i], NULL, core_main, t) != 0) {
+      fprintf(stderr, "Failed to start core %d\n", i);
+      fb_free(t->view);
+      t->view = NULL;
+      break;
+    }
+    started++;
+  }
+  for (int i = started; i < n; i++)
+    fb_present_leave(fb);
+
+  for (int i = 0; i < started; i++)
+    pthread_join(threads[i], NULL);
+  fb_front_set_cores(fb, 1);
+
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  double host_ms =
+      (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+
+  // Chip finishes when its slowest core does
+  memset(result, 0, sizeof(ExecutionResult));
+  result->mode = EXEC_MODE_PIPELINED;
+  result->total_instructions = im->size;
+
+  printf("\n=== MULTICORE RESULTS ===\n");
+  for (int i = 0; i < started; i++) {
+    ExecutionResult *r = tasks[i].result;
+    if (r) {
+      printf("Core %d: %u cycles, rows %d-%d\n", i, r->cycle_count,
+             tasks[i].view->clip_y0, tasks[i].view->clip_y1 - 1);
+      if (r->cycle_count > result->cycle_count)
+        result->cycle_count = r->cycle_count;
+      if (i == 0)
+        memcpy(result->final_regs, r->final_regs, sizeof(r->final_regs));
+    }
+    execution_free(r);
+    fb_free(tasks[i].view);
+  }
+  printf("Total cycles: %u (slowest core)\n", result->cycle_count);
+  printf("Host time: %.1f ms\n\n", host_ms);
+
+  free(tasks);
+  free(threads);
+  return result;
+}
+
 // ============================================================================
 // UNIFIED EXECUTION INTERFACE
 // ============================================================================
@@ -284,14 +536,44 @@ execute_pipelined(InstMem *im, LabelEntry labels[] __attribute__((unused)),
 ExecutionResult *execute_program(ExecutionMode mode, InstMem *im,
                                  LabelEntry labels[], int label_count,
                                  Framebuffer *fb, const char *trace_filename) {
-  open_trace(trace_filename);
+  // Every run starts from empty data memory
+  data_memory = dmem_create((uint32_t)sim_config.data_mem_mb);
+  if (!data_memory) {
+    fprintf(stderr, "Failed to reserve %d MB of data memory\n",
+            sim_config.data_mem_mb);
+    return NULL;
+  }
+  if (sim_config.mmio_base < data_memory->words) {
+    fprintf(stderr, "MMIO window at 0x%x overlaps %d MB of data memory\n",
+            sim_config.mmio_base, sim_config.data_mem_mb);
+    dmem_destroy(data_memory);
+    data_memory = NULL;
+    return NULL;
+  }
+  if (dmem_image_load(data_memory, &im->data) != 0) {
+    dmem_destroy(data_memory);
+    data_memory = NULL;
+    return NULL;
+  }
+
   ExecutionResult *res = NULL;
-  if (mode == EXEC_MODE_SINGLE_CYCLE) {
-    res = execute_single_cycle(im, labels, label_count, fb);
-  } else if (mode == EXEC_MODE_PIPELINED) {
-    res = execute_pipelined(im, labels, label_count, fb);
+  if (mode == EXEC_MODE_PIPELINED && sim_config.num_cores > 1) {
+    res = execute_multicore(im, labels, label_count, fb, trace_filename);
+  } else {
+    open_trace(trace_filename);
+    if (mode == EXEC_MODE_SINGLE_CYCLE) {
+      res = execute_single_cycle(im, labels, label_count, fb);
+    } else if (mode == EXEC_MODE_PIPELINED) {
+      res = execute_pipelined(im, labels, label_count, fb);
+    }
+    close_trace();
   }
-  close_trace();
+
+  uint32_t pages = atomic_load(&data_memory->resident);
+  printf("Data memory: %u of %u pages resident (%u KB of %d MB)\n\n", pages,
+         data_memory->words / DMEM_PAGE_WORDS, pages * 4, sim_config.data_mem_mb);
+  dmem_destroy(data_memory);
+  data_memory = NULL;
   return res;
 }
 
@@ -1,10 +1,33 @@
 #include "../include/executor.h"
-#include <math.h>
+#include "../include/config.h"
+#include "../include/mmio.h"
+#include "../include/trig.h"
+#include "../include/vector.h"
+#include "../include/xform.h"
 #include <stdio.h>
 
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
+__thread int core_id = 0;
+__thread int core_count = 1;
+
+uint32_t ex_latency(Opcode op, int32_t imm) {
+  switch (op) {
+  case OP_SIN:
+  case OP_COS:
+    return trig_latency(imm);
+  case OP_MUL:
+  case OP_MAC:
+    return sim_config.mul_latency;
+  case OP_DOT:
+    // One multiplier per component, then one cycle to add the products
+    return sim_config.mul_latency + 1;
+  case OP_MLOAD:
+    return MLOAD_CYCLES;
+  case OP_XFORM:
+    return xform_latency(imm);
+  default:
+    return 1;
+  }
+}
 
 /**
  * Unified instruction executor
@@ -12,11 +35,10 @@
  * Eliminates duplication and ensures consistent semantics
  */
 
-ExecResult execute_inst(Opcode op, int rd, int rs1 __attribute__((unused)),
-                        int rs2 __attribute__((unused)), int32_t imm,
+ExecResult execute_inst(Opcode op, int rd, int rs1, int rs2, int32_t imm,
                         uint32_t pc, int32_t rs1_val, int32_t rs2_val,
-                        int32_t *regs, Framebuffer *fb, int32_t *data_mem,
-                        size_t data_mem_size) {
+                        int32_t rd_val, int32_t *regs, Framebuffer *fb,
+                        DataMemory *mem) {
   ExecResult result = {.alu_result = 0,
                        .mem_data = 0,
                        .next_pc = pc + 1,
@@ -38,6 +60,51 @@ ExecResult execute_inst(Opcode op, int rd, int rs1 __attribute__((unused)),
     writeback_register(regs, rd, result.alu_result);
     break;
 
+  case OP_LUI:
+    result.alu_result = (int32_t)((uint32_t)imm << LUI_SHIFT);
+    writeback_register(regs, rd, result.alu_result);
+    break;
+
+  // ========== BITWISE AND SHIFT OPERATIONS ==========
+  // Shift amounts use the low 5 bits of rs2 or the immediate
+  case OP_AND:
+  case OP_ANDI:
+    result.alu_result = rs1_val & (op == OP_AND ? rs2_val : imm);
+    writeback_register(regs, rd, result.alu_result);
+    break;
+
+  case OP_OR:
+  case OP_ORI:
+    result.alu_result = rs1_val | (op == OP_OR ? rs2_val : imm);
+    writeback_register(regs, rd, result.alu_result);
+    break;
+
+  case OP_XOR:
+  case OP_XORI:
+    result.alu_result = rs1_val ^ (op == OP_XOR ? rs2_val : imm);
+    writeback_register(regs, rd, result.alu_result);
+    break;
+
+  case OP_SLL:
+  case OP_SLLI:
+    result.alu_result =
+        (int32_t)((uint32_t)rs1_val << ((op == OP_SLL ? rs2_val : imm) & 31));
+    writeback_register(regs, rd, result.alu_result);
+    break;
+
+  case OP_SRL:
+  case OP_SRLI:
+    result.alu_result =
+        (int32_t)((uint32_t)rs1_val >> ((op == OP_SRL ? rs2_val : imm) & 31));
+    writeback_register(regs, rd, result.alu_result);
+    break;
+
+  case OP_SRA:
+  case OP_SRAI:
+    result.alu_result = rs1_val >> ((op == OP_SRA ? rs2_val : imm) & 31);
+    writeback_register(regs, rd, result.alu_result);
+    break;
+
   case OP_SUB:
     result.alu_result = rs1_val - rs2_val;
     writeback_register(regs, rd, result.alu_result);
@@ -53,6 +120,55 @@ ExecResult execute_inst(Opcode op, int rd, int rs1 __attribute__((unused)),
     writeback_register(regs, rd, result.alu_result);
     break;
 
+  // ========== COMPARE AND SELECT ==========
+  // Branch-free alternatives to BLT/BEQ around a move
+  case OP_SLT:
+    result.alu_result = rs1_val < rs2_val;
+    writeback_register(regs, rd, result.alu_result);
+    break;
+
+  case OP_SEQ:
+    result.alu_result = rs1_val == rs2_val;
+    writeback_register(regs, rd, result.alu_result);
+    break;
+
+  case OP_CMOV:
+    // CMOV rd, rs1, rs2: rd = rs1 if rs2 != 0
+    result.alu_result = rs2_val ? rs1_val : rd_val;
+    writeback_register(regs, rd, result.alu_result);
+    break;
+
+  case OP_SEL:
+    // SEL rd, rs1, rs2: rd = rd != 0 ? rs1 : rs2
+    result.alu_result = rd_val ? rs1_val : rs2_val;
+    writeback_register(regs, rd, result.alu_result);
+    break;
+
+  case OP_MIN:
+    result.alu_result = rs1_val < rs2_val ? rs1_val : rs2_val;
+    writeback_register(regs, rd, result.alu_result);
+    break;
+
+  case OP_MAX:
+    result.alu_result = rs1_val > rs2_val ? rs1_val : rs2_val;
+    writeback_register(regs, rd, result.alu_result);
+    break;
+
+  // ========== MULTIPLY-ACCUMULATE ==========
+  case OP_MAC:
+    result.alu_result = rd_val + rs1_val * rs2_val;
+    writeback_register(regs, rd, result.alu_result);
+    break;
+
+  case OP_DOT:
+    // Components past the first are read from regs, which the pipelined
+    // model fills with their forwarded values
+    result.alu_result = rs1_val * rs2_val;
+    for (int i = 1; i < imm; i++)
+      result.alu_result += regs[rs1 + i] * regs[rs2 + i];
+    writeback_register(regs, rd, result.alu_result);
+    break;
+
   case OP_DIV:
     if (rs2_val != 0) {
       result.alu_result = rs1_val / rs2_val;
@@ -64,14 +180,19 @@ ExecResult execute_inst(Opcode op, int rd, int rs1 __attribute__((unused)),
     break;
 
   // ========== MEMORY OPERATIONS ==========
+  // Without data memory (pipelined EX stage) only the address is computed;
+  // the access itself happens in MEM. Addresses outside data memory may
+  // hit the MMIO window (mmio.h).
   case OP_LW: {
     // Load word: address = rs1_val + imm
     uint32_t addr = rs1_val + imm;
     result.is_memory_op = 1;
     result.mem_read_addr = addr;
 
-    if (addr < (uint32_t)data_mem_size) {
-      result.mem_data = data_mem[addr];
+    if (!mem) {
+      result.alu_result = addr;
+    } else if (dmem_load(mem, addr, &result.mem_data) == 0 ||
+               mmio_load(fb, addr, &result.mem_data) == 0) {
       result.alu_result = result.mem_data; // For single-cycle
       writeback_register(regs, rd, result.mem_data);
     } else {
@@ -86,8 +207,10 @@ ExecResult execute_inst(Opcode op, int rd, int rs1 __attribute__((unused)),
     result.is_memory_op = 1;
     result.mem_write_addr = addr;
 
-    if (addr < (uint32_t)data_mem_size) {
-      data_mem[addr] = rs2_val;
+    if (!mem) {
+      result.alu_result = addr;
+    } else if (dmem_store(mem, addr, rs2_val) == 0 ||
+               mmio_store(fb, addr, rs2_val) == 0) {
       result.alu_result = addr; // Return address for verification
     } else {
       fprintf(stderr, "Memory access violation: SW at address 0x%x\n", addr);
@@ -95,6 +218,42 @@ ExecResult execute_inst(Opcode op, int rd, int rs1 __attribute__((unused)),
     break;
   }
 
+  // ========== TRANSFORM UNIT ==========
+  // Without data memory (pipelined EX stage) only rs1 is passed on; the
+  // unit runs beside MEM.
+  case OP_MLOAD:
+    // MLOAD m, rs1: matrix m (imm) <- 16 words at rs1
+    result.alu_result = rs1_val;
+    if (mem && xform_mload(mem, rs1_val, imm) != 0)
+      fprintf(stderr, "Memory access violation: MLOAD at address 0x%x\n",
+              rs1_val);
+    break;
+
+  case OP_XFORM: {
+    // XFORM rd, rs1, imm: rd..rd+3 <- matrix * vec4 at rs1..rs1+3, or at
+    // data memory address rs1 (XFORM_MEM)
+    result.alu_result = rs1_val;
+    if (!mem)
+      break;
+    int32_t v[XFORM_LANES], out[XFORM_LANES];
+    if ((imm >> XFORM_MODE_SHIFT) & XFORM_MEM) {
+      if (xform_fetch(mem, rs1_val, v) != 0) {
+        fprintf(stderr, "Memory access violation: XFORM at address 0x%x\n",
+                rs1_val);
+        break;
+      }
+    } else {
+      v[0] = rs1_val;
+      for (int i = 1; i < XFORM_LANES; i++)
+        v[i] = regs[rs1 + i];
+    }
+    xform_apply(imm, v, out);
+    for (int i = 0; i < XFORM_LANES; i++)
+      writeback_register(regs, rd + i, out[i]);
+    result.alu_result = out[0];
+    break;
+  }
+
   // ========== CONTROL FLOW ==========
   case OP_BEQ: {
     // Branch if equal: target = pc + imm (if rs1_val == rs2_val)
@@ -126,21 +285,56 @@ ExecResult execute_inst(Opcode op, int rd, int rs1 __attribute__((unused)),
     break;
   }
 
+  // ========== MULTICORE ==========
+  case OP_COREID:
+    // COREID rd      -> index of this core
+    // COREID rd, 1   -> number of cores running the program
+    result.alu_result = (imm == 1) ? core_count : core_id;
+    writeback_register(regs, rd, result.alu_result);
+    break;
+
+  // ========== VECTOR OPERATIONS ==========
+  // rd/rs1/rs2 index the vector file; registers were validated by the parser
+  case OP_VSPLAT:
+    // VSPLAT vd, rs1, stride -> lane i = rs1 + i * stride
+    vec_splat(&vregs[rd], rs1_val, imm);
+    break;
+
+  case OP_VADD:
+    vec_add(&vregs[rd], &vregs[rs1], &vregs[rs2]);
+    break;
+
+  case OP_VSUB:
+    vec_sub(&vregs[rd], &vregs[rs1], &vregs[rs2]);
+    break;
+
+  case OP_VMUL:
+    vec_mul(&vregs[rd], &vregs[rs1], &vregs[rs2]);
+    break;
+
+  case OP_VMIN:
+    vec_min(&vregs[rd], &vregs[rs1], &vregs[rs2]);
+    break;
+
+  case OP_VBLT:
+    // VBLT va, vb -> mask bit i = va[i] < vb[i]
+    vmask = vec_lt_mask(&vregs[rs1], &vregs[rs2]);
+    result.alu_result = vmask;
+    break;
+
   // ========== TRIGONOMETRY ==========
-  case OP_SIN: {
-    // SIN rd, rs1 (rs1 is angle in degrees). Result scaled by 100.
-    double angle_rad = rs1_val * M_PI / 180.0;
-    result.alu_result = (int32_t)(sin(angle_rad) * 100);
+  case OP_SIN:
+    // SIN rd, rs1, mode. Mode 0: rs1 in degrees, result scaled by 100.
+    // Modes 1/2: rs1 in 1/65536 turns, Q15 table / Q16 CORDIC (trig.h).
+    result.alu_result = trig_sin(rs1_val, imm);
     writeback_register(regs, rd, result.alu_result);
     break;
-  }
-  case OP_COS: {
-    // COS rd, rs1 (rs1 is angle in degrees). Result scaled by 100.
-    double angle_rad = rs1_val * M_PI / 180.0;
-    result.alu_result = (int32_t)(cos(angle_rad) * 100);
+
+  case OP_COS:
+    // COS rd, rs1, mode (same formats as SIN)
+    result.alu_result = trig_cos(rs1_val, imm);
     writeback_register(regs, rd, result.alu_result);
     break;
-  }
 
   // ========== GRAPHICS OPERATIONS ==========
   case OP_MOVETO: {
@@ -204,6 +398,161 @@ ExecResult execute_inst(Opcode op, int rd, int rs1 __attribute__((unused)),
     break;
   }
 
+  case OP_VDRAWPIX: {
+    // VDRAWPIX rs_x, rs_y, mode -> current color at (x + lane, y) for the
+    // lanes selected by mode. The lane mask is resolved here (EX) and
+    // carried with the instruction so the IO stage can draw it later.
+    uint32_t lanes = vec_draw_mask(vmask, imm, sim_config.vector_lanes);
+    if (fb) {
+      fb_draw_span_mask(fb, rs1_val & 0xFFFF, rs2_val & 0xFFFF, lanes);
+    }
+    result.alu_result = lanes;
+    break;
+  }
+
+  case OP_HLINE:
+    // HLINE rs_x0, rs_x1, rd_y -> horizontal span, endpoints inclusive
+    if (fb) {
+      fb_fill_span(fb, rs1_val, rs2_val, rd_val);
+    }
+    result.alu_result = 0;
+    break;
+
+  case OP_FILLRECT:
+    // FILLRECT rs_x, rs_y -> filled rectangle from the pen to (x, y),
+    // corners inclusive; the pen does not move
+    if (fb) {
+      fb_fill_rect(fb, fb->draw_x, fb->draw_y, rs1_val, rs2_val);
+    }
+    result.alu_result = 0;
+    break;
+
+  case OP_TRI:
+    // TRI rs_a, rs_b, rd_c -> filled triangle over three packed vertices
+    if (fb) {
+      fb_fill_triangle(fb, VERTEX_X(rs1_val), VERTEX_Y(rs1_val),
+                       VERTEX_X(rs2_val), VERTEX_Y(rs2_val), VERTEX_X(rd_val),
+                       VERTEX_Y(rd_val));
+    }
+    result.alu_result = 0;
+    break;
+
+  // ========== DEPTH ==========
+  case OP_SETZ:
+    // SETZ rs1, test -> depth of following primitives; test 0 disables
+    // depth testing
+    if (fb) {
+      fb_set_z(fb, rs1_val, imm != 0);
+    }
+    result.alu_result = 0;
+    break;
+
+  case OP_DRAWPIXZ:
+    // DRAWPIXZ rs_x, rs_y -> depth-tested pixel at the current z
+    if (fb) {
+      fb_set_pixel_z(fb, rs1_val & 0xFFFF, rs2_val & 0xFFFF,
+                     fb->current_color);
+    }
+    result.alu_result = 0;
+    break;
+
+  case OP_CLEARZ:
+    if (fb) {
+      fb_clear_depth(fb);
+    }
+    result.alu_result = 0;
+    break;
+
+  // ========== DMA ==========
+  case OP_BLIT: {
+    // BLIT rs_src, rs_pos, rd_size, key -> copy a w x h block of words from
+    // data memory to the framebuffer. Without a modeled DMA engine the copy
+    // completes at once.
+    uint32_t addr = rs1_val;
+    int w = rd_val & 0xFFFF, h = (uint32_t)rd_val >> 16;
+    if (fb && mem) {
+      const int32_t *src = dmem_block(mem, addr, (uint64_t)w * h);
+      if (src) {
+        fb_blit(fb, VERTEX_X(rs2_val), VERTEX_Y(rs2_val), w, h,
+                (const uint32_t *)src, w, imm & 1);
+      } else {
+        fprintf(stderr, "Memory access violation: BLIT at address 0x%x\n",
+                addr);
+      }
+    }
+    result.alu_result = 0;
+    break;
+  }
+
+  case OP_DMAWAIT:
+    result.alu_result = 0;
+    break;
+
+  case OP_DMAPOLL:
+    result.alu_result = 1; // every BLIT completes immediately here
+    writeback_register(regs, rd, result.alu_result);
+    break;
+
+  // ========== TEXTURES ==========
+  case OP_SETTEX: {
+    // SETTEX rs_addr, rs_size, filter -> bind (h << 16 | w) words at rs_addr
+    uint32_t addr = rs1_val;
+    int w = rs2_val & 0xFFFF, h = (uint32_t)rs2_val >> 16;
+    if (fb && mem) {
+      const uint32_t *texels =
+          (const uint32_t *)dmem_block(mem, addr, (uint64_t)w * h);
+      if (!texels)
+        fprintf(stderr, "Memory access violation: SETTEX at address 0x%x\n",
+                addr);
+      if (fb_tex_bind(&fb->tex, texels, w, h, (FbTexFilter)imm) != 0)
+        fprintf(stderr, "SETTEX: %dx%d is not a power-of-two texture\n", w,
+                h);
+    }
+    result.alu_result = 0;
+    break;
+  }
+
+  case OP_TEXU:
+  case OP_TEXV:
+    // TEXU rs_c0, rs_dx, rd_dy -> screen-to-texel mapping of one axis
+    if (fb)
+      fb_tex_map(&fb->tex, op == OP_TEXV, rs1_val, rs2_val, rd_val);
+    result.alu_result = 0;
+    break;
+
+  case OP_TEX:
+    // TEX rd, rs_u, rs_v -> filtered texel. Without a framebuffer (EX
+    // stage) only u is passed on; the MEM stage samples.
+    result.alu_result = fb ? (int32_t)fb_tex_sample(&fb->tex, rs1_val, rs2_val)
+                           : rs1_val;
+    if (fb)
+      writeback_register(regs, rd, result.alu_result);
+    break;
+
+  case OP_SETBLEND:
+    // SETBLEND mode, alpha -> blending of following draws (imm = alpha << 2
+    // | mode)
+    if (fb) {
+      fb_set_blend(fb, (FbBlendMode)(imm & 3), (imm >> 2) & 0xFF);
+    }
+    result.alu_result = 0;
+    break;
+
+  case OP_PRESENT:
+    // Frame done: copy the back buffer's changes to the front buffer and
+    // emit it to the video stream
+    if (fb) {
+      fb_present(fb);
+    }
+    result.alu_result = 0;
+    break;
+
+  case OP_GFXSYNC:
+    // Barrier for the graphics coprocessor; drawing here is already
+    // synchronous, so there is nothing to wait for
+    result.alu_result = 0;
+    break;
+
   // ========== SPECIAL INSTRUCTIONS ==========
   case OP_NOP:
     result.alu_result = 0;
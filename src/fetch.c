@@ -1,13 +1,6 @@
 #include "../include/isa.h"
-#include <stdlib.h>
-#include <string.h>
 
 void if_stage(ProgramCounter *s, InstMem *im, IFIDreg *ifid) {
-  // Clear previous contents
-  if (ifid->instr_text) {
-    free(ifid->instr_text);
-    ifid->instr_text = NULL;
-  }
   ifid->valid = 0;
 
   // If PC out of bounds → bubble
@@ -15,7 +8,7 @@ void if_stage(ProgramCounter *s, InstMem *im, IFIDreg *ifid) {
     return;
   }
 
-  ifid->instr_text = strdup(im->lines[s->pc]);
+  ifid->instr = im->code[s->pc];
   ifid->pc = s->pc;
   ifid->valid = 1;
 
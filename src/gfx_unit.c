@@ -0,0 +1,440 @@
+#include "../include/gfx_unit.h"
+#include "../include/config.h"
+#include "../include/executor.h"
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// ========== HOST RING ==========
+
+static uint32_t next_pow2(uint32_t v) {
+  uint32_t p = 1;
+  while (p < v)
+    p <<= 1;
+  return p;
+}
+
+static int ring_init(GfxRing *r, uint32_t capacity) {
+  capacity = next_pow2(capacity);
+  r->slots = (GfxCommand *)calloc(capacity, sizeof(GfxCommand));
+  if (!r->slots)
+    return -1;
+  r->mask = capacity - 1;
+  atomic_init(&r->head, 0);
+  atomic_init(&r->tail, 0);
+  return 0;
+}
+
+static int ring_empty(GfxRing *r) {
+  return atomic_load(&r->head) == atomic_load(&r->tail);
+}
+
+// Producer side: spin (yielding) while the host ring is full
+static void ring_push(GfxRing *r, const GfxCommand *cmd) {
+  uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+  while (head - atomic_load_explicit(&r->tail, memory_order_acquire) >
+         r->mask)
+    sched_yield();
+
+  r->slots[head & r->mask] = *cmd;
+  atomic_store_explicit(&r->head, head + 1, memory_order_seq_cst);
+}
+
+// ========== RASTERIZER THREAD ==========
+
+// Draw one command and attribute its pixels in the unit's statistics
+static void gfx_execute(GfxUnit *gu, const GfxCommand *cmd) {
+  uint64_t before = gu->fb->pixels_written;
+
+  if (cmd->op == OP_VDRAWPIX) {
+    // Lane mask comes with the command; the vector state lives on the core
+    fb_draw_span_mask(gu->fb, cmd->rs1_val & 0xFFFF, cmd->rs2_val & 0xFFFF,
+                      cmd->mask);
+  } else if (cmd->op == OP_SETTEX) {
+    // Texture was bounds-checked and resolved in IO (NULL = unbind)
+    fb_tex_bind(&gu->fb->tex, (const uint32_t *)cmd->src,
+                cmd->rs2_val & 0xFFFF, (uint32_t)cmd->rs2_val >> 16,
+                (FbTexFilter)cmd->imm);
+  } else if (cmd->op == OP_BLIT) {
+    // Source block was bounds-checked and resolved in IO
+    int w = cmd->rd_val & 0xFFFF, h = (uint32_t)cmd->rd_val >> 16;
+    fb_blit(gu->fb, VERTEX_X(cmd->rs2_val), VERTEX_Y(cmd->rs2_val), w, h,
+            (const uint32_t *)cmd->src, w, cmd->imm & 1);
+  } else {
+    // Graphics ops never write registers or data memory
+    int32_t scratch_regs[32] = {0};
+    execute_inst(cmd->op, -1, -1, -1, cmd->imm, 0, cmd->rs1_val,
+                 cmd->rs2_val, cmd->rd_val, scratch_regs, gu->fb, NULL);
+  }
+
+  gu->stats.ops[cmd->op]++;
+  gu->stats.pixels[cmd->op] += gu->fb->pixels_written - before;
+}
+
+static void *rasterizer_main(void *arg) {
+  GfxUnit *gu = (GfxUnit *)arg;
+  GfxRing *r = &gu->ring;
+
+  for (;;) {
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+
+    if (tail == atomic_load_explicit(&r->head, memory_order_acquire)) {
+      if (!atomic_load(&gu->running))
+        break;
+
+      // Idle: park until the producer posts more work
+      pthread_mutex_lock(&gu->lock);
+      atomic_store(&gu->sleeping, 1);
+      if (ring_empty(r) && atomic_load(&gu->running))
+        pthread_cond_wait(&gu->wake, &gu->lock);
+      atomic_store(&gu->sleeping, 0);
+      pthread_mutex_unlock(&gu->lock);
+      continue;
+    }
+
+    gfx_execute(gu, &r->slots[tail & r->mask]);
+
+    // Retire only after drawing so that tail == head means fully drained
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+  }
+
+  return NULL;
+}
+
+static void wake_rasterizer(GfxUnit *gu) {
+  if (atomic_load(&gu->sleeping)) {
+    pthread_mutex_lock(&gu->lock);
+    pthread_cond_signal(&gu->wake);
+    pthread_mutex_unlock(&gu->lock);
+  }
+}
+
+// ========== LIFECYCLE ==========
+
+// Extra fill slots a textured span pixel takes: one texel fetch, or two
+// for bilinear (the 2x2 quad is read as two texel pairs)
+static int tex_slots(int bound, FbTexFilter filter) {
+  return bound ? (filter == FB_TEX_BILINEAR ? 2 : 1) : 0;
+}
+
+GfxUnit *gfx_unit_create(Framebuffer *fb, int depth) {
+  if (!fb || depth < 0)
+    return NULL;
+
+  GfxUnit *gu = (GfxUnit *)calloc(1, sizeof(GfxUnit));
+  if (!gu)
+    return NULL;
+
+  gu->fb = fb;
+  gu->depth = depth;
+  gu->pen_x = fb->draw_x;
+  gu->pen_y = fb->draw_y;
+  gu->blend = fb->blend;
+  gu->tex = tex_slots(fb->tex.texels != NULL, fb->tex.filter);
+  if (depth == 0)
+    return gu; // inline unit: no queue, no thread
+
+  gu->costs = (uint32_t *)calloc(depth, sizeof(uint32_t));
+
+  uint32_t capacity =
+      depth > GFX_RING_MIN_CAPACITY ? (uint32_t)depth : GFX_RING_MIN_CAPACITY;
+  if (!gu->costs || ring_init(&gu->ring, capacity) != 0) {
+    free(gu->costs);
+    free(gu);
+    return NULL;
+  }
+
+  pthread_mutex_init(&gu->lock, NULL);
+  pthread_cond_init(&gu->wake, NULL);
+  atomic_init(&gu->running, 1);
+  atomic_init(&gu->sleeping, 0);
+
+  if (pthread_create(&gu->thread, NULL, rasterizer_main, gu) != 0) {
+    fprintf(stderr, "Failed to start rasterizer thread\n");
+    pthread_mutex_destroy(&gu->lock);
+    pthread_cond_destroy(&gu->wake);
+    free(gu->ring.slots);
+    free(gu->costs);
+    free(gu);
+    return NULL;
+  }
+
+  return gu;
+}
+
+void gfx_unit_destroy(GfxUnit *gu) {
+  if (!gu)
+    return;
+  if (gu->depth == 0) {
+    free(gu);
+    return;
+  }
+
+  // Rasterizer drains whatever is left before it exits
+  pthread_mutex_lock(&gu->lock);
+  atomic_store(&gu->running, 0);
+  pthread_cond_signal(&gu->wake);
+  pthread_mutex_unlock(&gu->lock);
+  pthread_join(gu->thread, NULL);
+
+  pthread_mutex_destroy(&gu->lock);
+  pthread_cond_destroy(&gu->wake);
+  free(gu->ring.slots);
+  free(gu->costs);
+  free(gu);
+}
+
+// ========== ARCHITECTURAL MODEL ==========
+
+// Pixels covered by a TRI, estimated from its area and capped by its
+// clipped bounding box
+static uint32_t tri_pixels(const GfxUnit *gu, const GfxCommand *cmd) {
+  int x[3] = {VERTEX_X(cmd->rs1_val), VERTEX_X(cmd->rs2_val),
+              VERTEX_X(cmd->rd_val)};
+  int y[3] = {VERTEX_Y(cmd->rs1_val), VERTEX_Y(cmd->rs2_val),
+              VERTEX_Y(cmd->rd_val)};
+
+  int64_t area2 = (int64_t)(x[1] - x[0]) * (y[2] - y[0]) -
+                  (int64_t)(y[1] - y[0]) * (x[2] - x[0]);
+  if (area2 < 0)
+    area2 = -area2;
+
+  int bx0 = x[0], by0 = y[0], bx1 = x[0], by1 = y[0];
+  for (int k = 1; k < 3; k++) {
+    bx0 = x[k] < bx0 ? x[k] : bx0;
+    bx1 = x[k] > bx1 ? x[k] : bx1;
+    by0 = y[k] < by0 ? y[k] : by0;
+    by1 = y[k] > by1 ? y[k] : by1;
+  }
+  uint32_t box = fb_clip_rect(gu->fb, &bx0, &by0, &bx1, &by1);
+  return (uint64_t)area2 / 2 < box ? (uint32_t)(area2 / 2) : box;
+}
+
+// Modeled raster cost of a command in cycles (always >= 1)
+// pen_x, pen_y: draw position before the command (LINETO/DRAWSTEP/FILLRECT)
+// blend: SETBLEND mode in effect; blended pixels read the destination too,
+// so they take two fill slots
+// tex: extra fill slots per textured span pixel (see tex_slots())
+static uint32_t gfx_command_cost(const GfxUnit *gu, const GfxCommand *cmd,
+                                 int pen_x, int pen_y, FbBlendMode blend,
+                                 int tex) {
+  uint32_t pixels;
+  int x0, y0, x1, y1;
+
+  switch (cmd->op) {
+  case OP_DRAWPIX:
+  case OP_DRAWPIXZ:
+    pixels = 1;
+    break;
+  case OP_VDRAWPIX:
+    pixels = __builtin_popcount(cmd->mask);
+    break;
+  case OP_LINETO:
+    pixels = fb_line_pixels(gu->fb, pen_x, pen_y, cmd->rs1_val & 0xFFFF,
+                            cmd->rs2_val & 0xFFFF);
+    break;
+  case OP_DRAWSTEP:
+    pixels = fb_line_pixels(gu->fb, pen_x, pen_y,
+                            (int)((uint32_t)pen_x + (uint32_t)cmd->rs1_val),
+                            (int)((uint32_t)pen_y + (uint32_t)cmd->rs2_val));
+    break;
+  case OP_HLINE:
+    x0 = cmd->rs1_val, x1 = cmd->rs2_val, y0 = y1 = cmd->rd_val;
+    pixels = fb_clip_rect(gu->fb, &x0, &y0, &x1, &y1) * (1 + tex);
+    break;
+  case OP_FILLRECT:
+    x0 = pen_x, y0 = pen_y, x1 = cmd->rs1_val, y1 = cmd->rs2_val;
+    pixels = fb_clip_rect(gu->fb, &x0, &y0, &x1, &y1) * (1 + tex);
+    break;
+  case OP_TRI:
+    pixels = tri_pixels(gu, cmd) * (1 + tex);
+    break;
+  case OP_CLEARFB:
+  case OP_CLEARZ:
+    pixels = (uint32_t)(gu->fb->clip_x1 - gu->fb->clip_x0) *
+             (gu->fb->clip_y1 - gu->fb->clip_y0);
+    break;
+  case OP_BLIT:
+    // Copies ignore the blend mode, so they never pay the read slot
+    x0 = VERTEX_X(cmd->rs2_val), y0 = VERTEX_Y(cmd->rs2_val);
+    x1 = x0 + (cmd->rd_val & 0xFFFF) - 1;
+    y1 = y0 + (int)((uint32_t)cmd->rd_val >> 16) - 1;
+    pixels = x1 < x0 || y1 < y0 ? 0 : fb_clip_rect(gu->fb, &x0, &y0, &x1, &y1);
+    blend = FB_BLEND_NONE;
+    break;
+  default:
+    return 1; // state-only
+  }
+  if (blend != FB_BLEND_NONE && cmd->op != OP_CLEARFB && cmd->op != OP_CLEARZ)
+    pixels *= 2;
+
+  uint32_t ppc = sim_config.raster_ppc > 0 ? sim_config.raster_ppc : 1;
+  uint32_t cost = sim_config.raster_setup + (pixels + ppc - 1) / ppc;
+  return cost > 0 ? cost : 1;
+}
+
+// Track the draw position, blend mode and texturing the raster unit will
+// see for the next command
+static void pen_update(GfxUnit *gu, const GfxCommand *cmd) {
+  switch (cmd->op) {
+  case OP_MOVETO:
+  case OP_LINETO:
+    gu->pen_x = cmd->rs1_val & 0xFFFF;
+    gu->pen_y = cmd->rs2_val & 0xFFFF;
+    break;
+  case OP_DRAWSTEP:
+    gu->pen_x = (int)((uint32_t)gu->pen_x + (uint32_t)cmd->rs1_val);
+    gu->pen_y = (int)((uint32_t)gu->pen_y + (uint32_t)cmd->rs2_val);
+    break;
+  case OP_SETBLEND:
+    gu->blend = (FbBlendMode)(cmd->imm & 3);
+    break;
+  case OP_SETTEX:
+    gu->tex = tex_slots(cmd->src != NULL, (FbTexFilter)cmd->imm);
+    break;
+  default:
+    break;
+  }
+}
+
+void gfx_unit_tick(GfxUnit *gu) {
+  if (!gu)
+    return;
+
+  // The DMA engine runs alongside the raster unit, even when inline
+  if (gu->dma_busy > 0)
+    gu->dma_busy--;
+
+  if (gu->occupancy == 0)
+    return;
+
+  if (--gu->busy > 0)
+    return;
+
+  // Head command retired; start the next one
+  gu->q_head = (gu->q_head + 1) % gu->depth;
+  gu->occupancy--;
+  if (gu->occupancy > 0)
+    gu->busy = gu->costs[gu->q_head];
+}
+
+int gfx_unit_issue(GfxUnit *gu, const GfxCommand *cmd) {
+  if (gu->occupancy >= gu->depth) {
+    gu->full_stalls++;
+    return 0;
+  }
+
+  uint32_t cost =
+      gfx_command_cost(gu, cmd, gu->pen_x, gu->pen_y, gu->blend, gu->tex);
+  pen_update(gu, cmd);
+  gu->stats.cycles[cmd->op] += cost;
+
+  gu->costs[(gu->q_head + gu->occupancy) % gu->depth] = cost;
+  if (gu->occupancy == 0)
+    gu->busy = cost;
+  gu->occupancy++;
+  gu->commands++;
+
+  ring_push(&gu->ring, cmd);
+  wake_rasterizer(gu);
+  return 1;
+}
+
+uint32_t gfx_unit_draw(GfxUnit *gu, const GfxCommand *cmd) {
+  uint32_t cost = gfx_command_cost(
+      gu, cmd, gu->fb->draw_x, gu->fb->draw_y, gu->fb->blend,
+      tex_slots(gu->fb->tex.texels != NULL, gu->fb->tex.filter));
+  gu->stats.cycles[cmd->op] += cost;
+  gu->commands++;
+  gfx_execute(gu, cmd);
+  return cost;
+}
+
+int gfx_unit_blit(GfxUnit *gu, const GfxCommand *cmd) {
+  if (gu->dma_busy > 0) {
+    gu->dma_stalls++;
+    return 0;
+  }
+
+  uint32_t cost = gfx_command_cost(gu, cmd, 0, 0, FB_BLEND_NONE, 0);
+  gu->stats.cycles[OP_BLIT] += cost;
+  gu->dma_busy = cost;
+  gu->blits++;
+  gu->commands++;
+
+  // Host copy stays in program order with the raster commands
+  if (gu->depth == 0) {
+    gfx_execute(gu, cmd);
+  } else {
+    ring_push(&gu->ring, cmd);
+    wake_rasterizer(gu);
+  }
+  return 1;
+}
+
+int gfx_unit_dma_done(GfxUnit *gu, int wait) {
+  if (gu->dma_busy > 0) {
+    if (wait)
+      gu->dma_wait_stalls++;
+    return 0;
+  }
+
+  // Transfer is architecturally complete; make the host agree before the
+  // program reuses the source
+  gfx_unit_drain(gu);
+  return 1;
+}
+
+int gfx_unit_sync(GfxUnit *gu) {
+  if (gu->occupancy > 0 || gu->dma_busy > 0) {
+    gu->sync_stalls++;
+    return 0;
+  }
+
+  // Barrier is architecturally complete; make the host agree
+  gfx_unit_drain(gu);
+  return 1;
+}
+
+int gfx_unit_mmio(GfxUnit *gu) {
+  if (gu->occupancy > 0 || gu->dma_busy > 0) {
+    gu->mmio_stalls++;
+    return 0;
+  }
+
+  gfx_unit_drain(gu);
+  return 1;
+}
+
+uint32_t gfx_unit_pending_cycles(const GfxUnit *gu) {
+  if (!gu)
+    return 0;
+
+  uint32_t cycles = gu->occupancy > 0 ? gu->busy : 0;
+  for (int i = 1; i < gu->occupancy; i++)
+    cycles += gu->costs[(gu->q_head + i) % gu->depth];
+  return cycles > gu->dma_busy ? cycles : gu->dma_busy;
+}
+
+void gfx_unit_drain(GfxUnit *gu) {
+  if (!gu || gu->depth == 0)
+    return;
+  while (!ring_empty(&gu->ring)) {
+    wake_rasterizer(gu);
+    sched_yield();
+  }
+}
+
+// ========== STATISTICS ==========
+
+void gfx_stats_print(const GfxStats *stats, FILE *out) {
+  fprintf(out, "Raster unit (%d px/cycle, %d setup cycles):\n",
+          sim_config.raster_ppc, sim_config.raster_setup);
+  for (int op = 0; op < OP_COUNT; op++) {
+    if (!stats->ops[op] && !stats->cycles[op])
+      continue;
+    fprintf(out, "  %-8s %8lu ops %10lu pixels %10lu cycles\n",
+            op_name((Opcode)op), stats->ops[op], stats->pixels[op],
+            stats->cycles[op]);
+  }
+}
@@ -1,23 +1,172 @@
 #include "../include/graphics.h"
+#include <fcntl.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
-// Initialize framebuffer
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__SSSE3__) && !defined(__AVX2__)
+#include <tmmintrin.h>
+#endif
+
+static const char *const format_names[FB_FORMAT_COUNT] = {
+    [FB_FORMAT_ARGB8888] = "argb8888",
+    [FB_FORMAT_RGB565] = "rgb565",
+    [FB_FORMAT_INDEXED8] = "indexed8",
+};
+
+static const char *const layout_names[FB_LAYOUT_COUNT] = {
+    [FB_LAYOUT_LINEAR] = "linear",
+    [FB_LAYOUT_TILED] = "tiled",
+};
+
+static const char *const blend_names[FB_BLEND_COUNT] = {
+    [FB_BLEND_NONE] = "none",
+    [FB_BLEND_OVER] = "over",
+    [FB_BLEND_ADD] = "add",
+    [FB_BLEND_MULTIPLY] = "multiply",
+};
+
+static const char *const tex_filter_names[FB_TEX_FILTER_COUNT] = {
+    [FB_TEX_NEAREST] = "nearest",
+    [FB_TEX_BILINEAR] = "bilinear",
+};
+
+static const int format_bpp[FB_FORMAT_COUNT] = {
+    [FB_FORMAT_ARGB8888] = 4,
+    [FB_FORMAT_RGB565] = 2,
+    [FB_FORMAT_INDEXED8] = 1,
+};
+
+// Initialize the default 256x256 ARGB framebuffer
 Framebuffer *fb_init(void) {
+  return fb_create(FB_WIDTH, FB_HEIGHT, FB_FORMAT_ARGB8888, FB_LAYOUT_LINEAR);
+}
+
+// Create a cleared width x height framebuffer in the given pixel format
+// and memory layout
+Framebuffer *fb_create(int width, int height, PixelFormat format,
+                       FbLayout layout) {
+  if (width < 1 || width > FB_MAX_WIDTH || height < 1 ||
+      height > FB_MAX_HEIGHT || format < 0 || format >= FB_FORMAT_COUNT ||
+      layout < 0 || layout >= FB_LAYOUT_COUNT)
+    return NULL;
+
   Framebuffer *fb = (Framebuffer *)malloc(sizeof(Framebuffer));
   if (!fb)
     return NULL;
 
-  fb->pixels = (Pixel *)calloc(FB_SIZE, sizeof(Pixel));
-  if (!fb->pixels) {
+  fb->width = width;
+  fb->height = height;
+  fb->format = format;
+  fb->bpp = format_bpp[format];
+  fb->layout = layout;
+  fb->tiles_x = (width + FB_TILE - 1) / FB_TILE;
+  if (layout == FB_LAYOUT_TILED) {
+    int tiles_y = (height + FB_TILE - 1) / FB_TILE;
+    fb->buffer_pixels = (size_t)fb->tiles_x * tiles_y * FB_TILE * FB_TILE;
+  } else {
+    fb->buffer_pixels = (size_t)width * height;
+  }
+  fb->palette = NULL;
+  fb->pixels = calloc(fb->buffer_pixels, fb->bpp);
+  fb->dirty_tiles_x = (width + FB_DIRTY_TILE - 1) / FB_DIRTY_TILE;
+  fb->dirty_tiles_y = (height + FB_DIRTY_TILE - 1) / FB_DIRTY_TILE;
+  fb->dirty = (atomic_uchar *)calloc(
+      (size_t)fb->dirty_tiles_x * fb->dirty_tiles_y, sizeof(atomic_uchar));
+  if (!fb->pixels || !fb->dirty) {
+    free(fb->pixels);
+    free(fb->dirty);
     free(fb);
     return NULL;
   }
 
-  fb->current_color = 0xFFFFFFFF; // White
+  if (format == FB_FORMAT_INDEXED8) {
+    fb->palette = (Pixel *)malloc(256 * sizeof(Pixel));
+    if (!fb->palette) {
+      free(fb->pixels);
+      free(fb->dirty);
+      free(fb);
+      return NULL;
+    }
+    // 3-3-2 RGB, each channel scaled to the full 0..255 range
+    for (int i = 0; i < 256; i++) {
+      uint8_t r = (uint8_t)(((i >> 5) & 7) * 255 / 7);
+      uint8_t g = (uint8_t)(((i >> 2) & 7) * 255 / 7);
+      uint8_t b = (uint8_t)((i & 3) * 255 / 3);
+      fb->palette[i] = fb_color_rgb(r, g, b);
+    }
+  }
+
   fb->draw_x = 0;
   fb->draw_y = 0;
+  fb->pixels_written = 0;
+
+  fb->clip_x0 = 0;
+  fb->clip_y0 = 0;
+  fb->clip_x1 = width;
+  fb->clip_y1 = height;
+  fb->owns_pixels = 1;
+
+  fb->depth = NULL;
+  fb->depth_bits = 0;
+  fb->current_z = 0;
+  fb->depth_test = 0;
+
+  fb->front = NULL;
+  fb->presented = 0;
+
+  fb->blend = FB_BLEND_NONE;
+  fb->blend_alpha = 255;
+  memset(&fb->tex, 0, sizeof(fb->tex));
+  fb_set_color(fb, 0xFFFFFFFF); // White
+  return fb;
+}
+
+// Attach a 16- or 32-bit depth buffer, cleared to the far plane.
+// Views created afterwards share it. Returns 0 on success.
+int fb_enable_depth(Framebuffer *fb, int bits) {
+  if (!fb || !fb->owns_pixels || (bits != 16 && bits != 32))
+    return -1;
+
+  void *depth = malloc(fb->buffer_pixels * (bits / 8));
+  if (!depth)
+    return -1;
+
+  free(fb->depth);
+  fb->depth = depth;
+  fb->depth_bits = bits;
+  fb_clear_depth(fb);
+  return 0;
+}
+
+// Create a view of `parent` that shares its pixels but has its own color and
+// draw position, and only writes inside [x0, x1) x [y0, y1). Used to give
+// each core ownership of one screen tile of a shared framebuffer.
+Framebuffer *fb_view(Framebuffer *parent, int x0, int y0, int x1, int y1) {
+  if (!parent || !parent->pixels)
+    return NULL;
+
+  Framebuffer *fb = (Framebuffer *)malloc(sizeof(Framebuffer));
+  if (!fb)
+    return NULL;
+
+  *fb = *parent;
+  fb->pixels_written = 0;
+  fb->clip_x0 = x0 < 0 ? 0 : x0;
+  fb->clip_y0 = y0 < 0 ? 0 : y0;
+  fb->clip_x1 = x1 > parent->width ? parent->width : x1;
+  fb->clip_y1 = y1 > parent->height ? parent->height : y1;
+  fb->owns_pixels = 0;
+  fb->presented = parent->front ? parent->front->frames : 0;
 
   return fb;
 }
@@ -25,44 +174,344 @@ Framebuffer *fb_init(void) {
 // Free framebuffer
 void fb_free(Framebuffer *fb) {
   if (fb) {
-    if (fb->pixels)
+    if (fb->owns_pixels) {
       free(fb->pixels);
+      free(fb->depth);
+      free(fb->palette);
+      free(fb->dirty);
+      if (fb->front) {
+        pthread_mutex_destroy(&fb->front->lock);
+        pthread_cond_destroy(&fb->front->emitted);
+        free(fb->front->rgb);
+        free(fb->front);
+      }
+    }
     free(fb);
   }
 }
 
-// Clear framebuffer to black
+// ========== PIXEL FORMATS ==========
+
+int fb_format_from_name(const char *name) {
+  for (int f = 0; f < FB_FORMAT_COUNT; f++) {
+    if (name && strcmp(name, format_names[f]) == 0)
+      return f;
+  }
+  return -1;
+}
+
+int fb_layout_from_name(const char *name) {
+  for (int l = 0; l < FB_LAYOUT_COUNT; l++) {
+    if (name && strcmp(name, layout_names[l]) == 0)
+      return l;
+  }
+  return -1;
+}
+
+int fb_blend_from_name(const char *name) {
+  for (int b = 0; b < FB_BLEND_COUNT; b++) {
+    if (name && strcasecmp(name, blend_names[b]) == 0)
+      return b;
+  }
+  return -1;
+}
+
+const char *fb_layout_name(FbLayout layout) {
+  return (layout >= 0 && layout < FB_LAYOUT_COUNT) ? layout_names[layout]
+                                                   : "unknown";
+}
+
+const char *fb_format_name(PixelFormat format) {
+  return (format >= 0 && format < FB_FORMAT_COUNT) ? format_names[format]
+                                                   : "unknown";
+}
+
+// Nearest palette entry by squared RGB distance
+static uint8_t palette_nearest(const Pixel *palette, Pixel color) {
+  int r = (color >> 16) & 0xFF, g = (color >> 8) & 0xFF, b = color & 0xFF;
+  int best = 0, best_d = 0x7FFFFFFF;
+  for (int i = 0; i < 256 && best_d; i++) {
+    int dr = r - (int)((palette[i] >> 16) & 0xFF);
+    int dg = g - (int)((palette[i] >> 8) & 0xFF);
+    int db = b - (int)(palette[i] & 0xFF);
+    int d = dr * dr + dg * dg + db * db;
+    if (d < best_d)
+      best = i, best_d = d;
+  }
+  return (uint8_t)best;
+}
+
+uint32_t fb_pack_color(const Framebuffer *fb, Pixel color) {
+  switch (fb->format) {
+  case FB_FORMAT_RGB565:
+    return ((color >> 8) & 0xF800) | ((color >> 5) & 0x07E0) |
+           ((color >> 3) & 0x001F);
+  case FB_FORMAT_INDEXED8:
+    return palette_nearest(fb->palette, color);
+  default:
+    return color;
+  }
+}
+
+Pixel fb_unpack_color(const Framebuffer *fb, uint32_t native) {
+  switch (fb->format) {
+  case FB_FORMAT_RGB565: {
+    uint32_t r = (native >> 11) & 0x1F, g = (native >> 5) & 0x3F,
+             b = native & 0x1F;
+    return fb_color_rgb((uint8_t)(r << 3 | r >> 2), (uint8_t)(g << 2 | g >> 4),
+                        (uint8_t)(b << 3 | b >> 2));
+  }
+  case FB_FORMAT_INDEXED8:
+    return fb->palette[native & 0xFF];
+  default:
+    return native;
+  }
+}
+
+int fb_set_palette(Framebuffer *fb, const Pixel *colors, int count) {
+  if (!fb || !fb->palette || !colors || count < 0 || count > 256)
+    return -1;
+  memcpy(fb->palette, colors, (size_t)count * sizeof(Pixel));
+  fb->native_color = fb_pack_color(fb, fb->current_color);
+  return 0;
+}
+
+// Buffer index of pixel (x, y)
+static inline size_t pix_index(const Framebuffer *fb, int x, int y) {
+  if (fb->layout == FB_LAYOUT_TILED) {
+    size_t tile = (size_t)(y / FB_TILE) * fb->tiles_x + x / FB_TILE;
+    return tile * FB_TILE * FB_TILE + (y % FB_TILE) * FB_TILE + x % FB_TILE;
+  }
+  return (size_t)y * fb->width + x;
+}
+
+// Pixels from (x, y) rightwards, at most n, that are consecutive in the
+// buffer: the rest of the row when linear, the rest of the tile row when
+// tiled. Row spans are stored as a sequence of such runs.
+static inline int run_length(const Framebuffer *fb, int x, int n) {
+  if (fb->layout == FB_LAYOUT_TILED) {
+    int left = FB_TILE - x % FB_TILE;
+    return n < left ? n : left;
+  }
+  return n;
+}
+
+// memset() pixels x .. x + n - 1 of row y in a buffer of `bytes`-wide
+// entries laid out like the framebuffer (pixels or depth)
+static void memset_row(const Framebuffer *fb, void *buf, int bytes, int x,
+                       int y, int n, int value) {
+  while (n > 0) {
+    int len = run_length(fb, x, n);
+    memset((uint8_t *)buf + pix_index(fb, x, y) * bytes, value,
+           (size_t)len * bytes);
+    x += len;
+    n -= len;
+  }
+}
+
+// Store / load one native pixel at buffer index idx
+static inline void pix_store(Framebuffer *fb, size_t idx, uint32_t v) {
+  switch (fb->bpp) {
+  case 4:
+    ((uint32_t *)fb->pixels)[idx] = v;
+    break;
+  case 2:
+    ((uint16_t *)fb->pixels)[idx] = (uint16_t)v;
+    break;
+  default:
+    ((uint8_t *)fb->pixels)[idx] = (uint8_t)v;
+    break;
+  }
+}
+
+static inline uint32_t pix_load(const Framebuffer *fb, size_t idx) {
+  switch (fb->bpp) {
+  case 4:
+    return ((const uint32_t *)fb->pixels)[idx];
+  case 2:
+    return ((const uint16_t *)fb->pixels)[idx];
+  default:
+    return ((const uint8_t *)fb->pixels)[idx];
+  }
+}
+
+// Pack a color, reusing the cached packing of the current color
+static inline uint32_t native_of(const Framebuffer *fb, Pixel color) {
+  return color == fb->current_color ? fb->native_color
+                                    : fb_pack_color(fb, color);
+}
+
+static void blend_native(Framebuffer *fb, size_t idx, int n);
+
+// Draw the current color at buffer index idx, blended when SETBLEND is on
+static inline void draw_at(Framebuffer *fb, size_t idx) {
+  if (fb->blend != FB_BLEND_NONE)
+    blend_native(fb, idx, 1);
+  else
+    pix_store(fb, idx, fb->native_color);
+}
+
+// ========== DIRTY TRACKING ==========
+
+// Set `bits` on dirty tile t. Checked first so repeated marks of a tile
+// stay plain loads; atomic because views of different cores can share a
+// tile on their band boundary.
+static inline void mark_tile(Framebuffer *fb, size_t t, unsigned char bits) {
+  if ((atomic_load_explicit(&fb->dirty[t], memory_order_relaxed) & bits) !=
+      bits)
+    atomic_fetch_or_explicit(&fb->dirty[t], bits, memory_order_relaxed);
+}
+
+static inline void mark_pixel(Framebuffer *fb, int x, int y) {
+  mark_tile(fb,
+            (size_t)(y / FB_DIRTY_TILE) * fb->dirty_tiles_x + x / FB_DIRTY_TILE,
+            FB_DIRTY_CHANGED | FB_DIRTY_INK);
+}
+
+// Mark the drawn pixel rectangle [x0, x1) x [y0, y1) (non-empty, in bounds)
+static void mark_rect(Framebuffer *fb, int x0, int y0, int x1, int y1) {
+  for (int ty = y0 / FB_DIRTY_TILE; ty <= (y1 - 1) / FB_DIRTY_TILE; ty++) {
+    size_t row = (size_t)ty * fb->dirty_tiles_x;
+    for (int tx = x0 / FB_DIRTY_TILE; tx <= (x1 - 1) / FB_DIRTY_TILE; tx++)
+      mark_tile(fb, row + tx, FB_DIRTY_CHANGED | FB_DIRTY_INK);
+  }
+}
+
+// Mark a cleared rectangle: changed, and tiles it covers whole are black
+static void mark_cleared(Framebuffer *fb, int x0, int y0, int x1, int y1) {
+  for (int ty = y0 / FB_DIRTY_TILE; ty <= (y1 - 1) / FB_DIRTY_TILE; ty++) {
+    int py0 = ty * FB_DIRTY_TILE, py1 = py0 + FB_DIRTY_TILE;
+    if (py1 > fb->height)
+      py1 = fb->height;
+    for (int tx = x0 / FB_DIRTY_TILE; tx <= (x1 - 1) / FB_DIRTY_TILE; tx++) {
+      int px0 = tx * FB_DIRTY_TILE, px1 = px0 + FB_DIRTY_TILE;
+      if (px1 > fb->width)
+        px1 = fb->width;
+      atomic_uchar *t = &fb->dirty[(size_t)ty * fb->dirty_tiles_x + tx];
+      if (px0 >= x0 && px1 <= x1 && py0 >= y0 && py1 <= y1)
+        atomic_store_explicit(t, FB_DIRTY_CHANGED, memory_order_relaxed);
+      else
+        atomic_fetch_or_explicit(t, FB_DIRTY_CHANGED, memory_order_relaxed);
+    }
+  }
+}
+
+static inline unsigned char tile_state(const Framebuffer *fb, int tx, int ty) {
+  return atomic_load_explicit(&fb->dirty[(size_t)ty * fb->dirty_tiles_x + tx],
+                              memory_order_relaxed);
+}
+
+int fb_dirty_bounds(const Framebuffer *fb, int *x0, int *y0, int *x1,
+                    int *y1) {
+  if (!fb || !fb->dirty)
+    return 0;
+
+  int count = 0;
+  int lx = fb->dirty_tiles_x, ly = fb->dirty_tiles_y, hx = -1, hy = -1;
+  for (int ty = 0; ty < fb->dirty_tiles_y; ty++) {
+    for (int tx = 0; tx < fb->dirty_tiles_x; tx++) {
+      if (!(tile_state(fb, tx, ty) & FB_DIRTY_CHANGED))
+        continue;
+      count++;
+      lx = tx < lx ? tx : lx, hx = tx > hx ? tx : hx;
+      ly = ty < ly ? ty : ly, hy = ty > hy ? ty : hy;
+    }
+  }
+  if (!count)
+    return 0;
+
+  *x0 = lx * FB_DIRTY_TILE;
+  *y0 = ly * FB_DIRTY_TILE;
+  *x1 = (hx + 1) * FB_DIRTY_TILE < fb->width ? (hx + 1) * FB_DIRTY_TILE
+                                            : fb->width;
+  *y1 = (hy + 1) * FB_DIRTY_TILE < fb->height ? (hy + 1) * FB_DIRTY_TILE
+                                             : fb->height;
+  return count;
+}
+
+// ========== FRAMEBUFFER ACCESS ==========
+
+// Clear framebuffer (or a view's region) to black
 void fb_clear(Framebuffer *fb) {
   if (!fb || !fb->pixels)
     return;
-  memset(fb->pixels, 0, FB_SIZE * sizeof(Pixel));
+
+  int w = fb->clip_x1 - fb->clip_x0;
+  int h = fb->clip_y1 - fb->clip_y0;
+  if (w <= 0 || h <= 0)
+    return;
+
+  // Black packs to zero in every format (palette index 0 by default)
+  if (w == fb->width && h == fb->height) {
+    memset(fb->pixels, 0, fb->buffer_pixels * fb->bpp);
+  } else if (w == fb->width && fb->layout == FB_LAYOUT_LINEAR) {
+    memset((uint8_t *)fb->pixels + pix_index(fb, 0, fb->clip_y0) * fb->bpp, 0,
+           (size_t)h * w * fb->bpp);
+  } else {
+    for (int y = fb->clip_y0; y < fb->clip_y1; y++)
+      memset_row(fb, fb->pixels, fb->bpp, fb->clip_x0, y, w, 0);
+  }
+  mark_cleared(fb, fb->clip_x0, fb->clip_y0, fb->clip_x1, fb->clip_y1);
+  fb->pixels_written += (uint64_t)w * h;
+}
+
+// Reset the depth buffer (or a view's region) to the far plane
+void fb_clear_depth(Framebuffer *fb) {
+  if (!fb || !fb->depth)
+    return;
+
+  int w = fb->clip_x1 - fb->clip_x0;
+  int h = fb->clip_y1 - fb->clip_y0;
+  int bytes = fb->depth_bits / 8;
+  if (w <= 0 || h <= 0)
+    return;
+
+  // All-ones is the farthest depth in either format
+  if (w == fb->width && h == fb->height) {
+    memset(fb->depth, 0xFF, fb->buffer_pixels * bytes);
+  } else if (w == fb->width && fb->layout == FB_LAYOUT_LINEAR) {
+    memset((uint8_t *)fb->depth + pix_index(fb, 0, fb->clip_y0) * bytes, 0xFF,
+           (size_t)h * w * bytes);
+  } else {
+    for (int y = fb->clip_y0; y < fb->clip_y1; y++)
+      memset_row(fb, fb->depth, bytes, fb->clip_x0, y, w, 0xFF);
+  }
+}
+
+// Set the depth of subsequent primitives and turn depth testing on or off
+void fb_set_z(Framebuffer *fb, int32_t z, int test) {
+  if (!fb)
+    return;
+  fb->current_z = z < 0 ? 0 : (uint32_t)z;
+  fb->depth_test = test;
 }
 
 // Check if coordinates are in bounds
-int fb_in_bounds(int x, int y) {
-  return (x >= 0 && x < FB_WIDTH && y >= 0 && y < FB_HEIGHT);
+int fb_in_bounds(const Framebuffer *fb, int x, int y) {
+  return (x >= 0 && x < fb->width && y >= 0 && y < fb->height);
 }
 
 // Set pixel at (x, y) with given color
 void fb_set_pixel(Framebuffer *fb, int x, int y, Pixel color) {
   if (!fb || !fb->pixels)
     return;
-  if (!fb_in_bounds(x, y))
+  if (x < fb->clip_x0 || x >= fb->clip_x1 || y < fb->clip_y0 ||
+      y >= fb->clip_y1)
     return;
 
-  int index = y * FB_WIDTH + x;
-  fb->pixels[index] = color;
+  pix_store(fb, pix_index(fb, x, y), native_of(fb, color));
+  mark_pixel(fb, x, y);
+  fb->pixels_written++;
 }
 
-// Get pixel at (x, y)
+// Get pixel at (x, y) as ARGB
 Pixel fb_get_pixel(Framebuffer *fb, int x, int y) {
   if (!fb || !fb->pixels)
     return 0;
-  if (!fb_in_bounds(x, y))
+  if (!fb_in_bounds(fb, x, y))
     return 0;
 
-  int index = y * FB_WIDTH + x;
-  return fb->pixels[index];
+  return fb_unpack_color(fb, pix_load(fb, pix_index(fb, x, y)));
 }
 
 // Set current drawing color
@@ -70,58 +519,1095 @@ void fb_set_color(Framebuffer *fb, Pixel color) {
   if (!fb)
     return;
   fb->current_color = color;
+  fb->native_color = fb_pack_color(fb, color);
+}
+
+void fb_set_blend(Framebuffer *fb, FbBlendMode mode, int alpha) {
+  if (!fb)
+    return;
+  fb->blend = (mode >= 0 && mode < FB_BLEND_COUNT) ? mode : FB_BLEND_NONE;
+  fb->blend_alpha = alpha < 0 ? 0 : alpha > 255 ? 255 : (uint8_t)alpha;
+}
+
+// Store the current color at (x, y) if it is writable
+static inline void draw_native(Framebuffer *fb, int x, int y) {
+  if (x < fb->clip_x0 || x >= fb->clip_x1 || y < fb->clip_y0 ||
+      y >= fb->clip_y1)
+    return;
+
+  draw_at(fb, pix_index(fb, x, y));
+  mark_pixel(fb, x, y);
+  fb->pixels_written++;
 }
 
 // Draw pixel at current position
 void fb_draw_pixel(Framebuffer *fb, int x, int y) {
+  if (!fb || !fb->pixels)
+    return;
+  draw_native(fb, x, y);
+}
+
+// Draw line from current position by (dx, dy) offset
+void fb_draw_step(Framebuffer *fb, int dx, int dy) {
   if (!fb)
     return;
-  fb_set_pixel(fb, x, y, fb->current_color);
+
+  // Pen coordinates wrap like 32-bit register arithmetic
+  int x2 = (int)((uint32_t)fb->draw_x + (uint32_t)dx);
+  int y2 = (int)((uint32_t)fb->draw_y + (uint32_t)dy);
+
+  fb_draw_line(fb, fb->draw_x, fb->draw_y, x2, y2);
+
+  fb->draw_x = x2;
+  fb->draw_y = y2;
+}
+
+// Draw current color at (x + i, y) for every set bit i of mask (VDRAWPIX)
+void fb_draw_span_mask(Framebuffer *fb, int x, int y, uint32_t mask) {
+  if (!fb || !fb->pixels)
+    return;
+
+  while (mask) {
+    int i = __builtin_ctz(mask);
+    draw_native(fb, x + i, y);
+    mask &= mask - 1;
+  }
+}
+
+// Clip the rectangle with inclusive corners (x0, y0) and (x1, y1), in any
+// order, to the writable region. On return the corners describe the
+// half-open result [x0, x1) x [y0, y1); returns its area in pixels.
+// Corners are raw register values, so the exclusive edge is formed in 64
+// bits: an INT_MAX corner must clip, not wrap.
+uint32_t fb_clip_rect(const Framebuffer *fb, int *x0, int *y0, int *x1,
+                      int *y1) {
+  int64_t lx = *x0 < *x1 ? *x0 : *x1;
+  int64_t hx = (int64_t)(*x0 < *x1 ? *x1 : *x0) + 1;
+  int64_t ly = *y0 < *y1 ? *y0 : *y1;
+  int64_t hy = (int64_t)(*y0 < *y1 ? *y1 : *y0) + 1;
+
+  if (lx < fb->clip_x0)
+    lx = fb->clip_x0;
+  if (hx > fb->clip_x1)
+    hx = fb->clip_x1;
+  if (ly < fb->clip_y0)
+    ly = fb->clip_y0;
+  if (hy > fb->clip_y1)
+    hy = fb->clip_y1;
+
+  *x0 = (int)lx, *x1 = (int)hx, *y0 = (int)ly, *y1 = (int)hy;
+  if (lx >= hx || ly >= hy)
+    return 0;
+  return (uint32_t)(hx - lx) * (uint32_t)(hy - ly);
+}
+
+// ========== BLENDING ==========
+
+// Rounded x / 255 for x in [0, 255 * 255]
+static inline uint32_t div255(uint32_t x) {
+  x += 128;
+  return (x + (x >> 8)) >> 8;
+}
+
+// Blend source color s into destination d with constant alpha a
+static Pixel blend_argb(Pixel d, Pixel s, uint32_t a, FbBlendMode mode) {
+  Pixel out = 0xFF000000u;
+  for (int shift = 0; shift < 24; shift += 8) {
+    uint32_t dc = (d >> shift) & 0xFF, sc = (s >> shift) & 0xFF, c;
+    switch (mode) {
+    case FB_BLEND_ADD:
+      c = dc + div255(sc * a);
+      c = c > 255 ? 255 : c;
+      break;
+    case FB_BLEND_MULTIPLY:
+      c = div255(div255(sc * dc) * a + dc * (255 - a));
+      break;
+    default:
+      c = div255(sc * a + dc * (255 - a));
+      break;
+    }
+    out |= c << shift;
+  }
+  return out;
+}
+
+#if defined(__AVX2__)
+static inline __m256i div255_epu16_256(__m256i x) {
+  x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+  return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+// Blend 16-bit channels d (four pixels) with source s: s * a + d * (255 - a)
+// fits 16 bits unsigned, so every product stays in one lane
+static inline __m256i blend_epu16_256(__m256i d, __m256i s, __m256i sa,
+                                      __m256i a, __m256i inv,
+                                      FbBlendMode mode) {
+  if (mode == FB_BLEND_MULTIPLY)
+    return div255_epu16_256(
+        _mm256_add_epi16(_mm256_mullo_epi16(div255_epu16_256(
+                                                _mm256_mullo_epi16(d, s)),
+                                            a),
+                         _mm256_mullo_epi16(d, inv)));
+  return div255_epu16_256(_mm256_add_epi16(sa, _mm256_mullo_epi16(d, inv)));
+}
+#endif
+
+#if defined(__SSE2__)
+static inline __m128i div255_epu16(__m128i x) {
+  x = _mm_add_epi16(x, _mm_set1_epi16(128));
+  return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// 128-bit version of blend_epu16_256 (two pixels)
+static inline __m128i blend_epu16(__m128i d, __m128i s, __m128i sa, __m128i a,
+                                  __m128i inv, FbBlendMode mode) {
+  if (mode == FB_BLEND_MULTIPLY)
+    return div255_epu16(_mm_add_epi16(
+        _mm_mullo_epi16(div255_epu16(_mm_mullo_epi16(d, s)), a),
+        _mm_mullo_epi16(d, inv)));
+  return div255_epu16(_mm_add_epi16(sa, _mm_mullo_epi16(d, inv)));
+}
+#endif
+
+// Blend color into n consecutive ARGB8888 pixels. Channels are widened to
+// 16 bits; ADD only needs the alpha-scaled source, added with saturation.
+static void blend_pixels(Pixel *dst, Pixel color, uint32_t a,
+                         FbBlendMode mode, int n) {
+  int i = 0;
+#if defined(__AVX2__)
+  {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i opaque = _mm256_set1_epi32((int)0xFF000000u);
+    const __m256i s = _mm256_unpacklo_epi8(_mm256_set1_epi32((int)color), zero);
+    const __m256i av = _mm256_set1_epi16((short)a);
+    const __m256i inv = _mm256_set1_epi16((short)(255 - a));
+    const __m256i sa = _mm256_mullo_epi16(s, av);
+    const __m256i sa8 =
+        _mm256_packus_epi16(div255_epu16_256(sa), div255_epu16_256(sa));
+    for (; i + 8 <= n; i += 8) {
+      __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+      __m256i r;
+      if (mode == FB_BLEND_ADD) {
+        r = _mm256_adds_epu8(d, sa8);
+      } else {
+        __m256i lo = _mm256_unpacklo_epi8(d, zero);
+        __m256i hi = _mm256_unpackhi_epi8(d, zero);
+        r = _mm256_packus_epi16(blend_epu16_256(lo, s, sa, av, inv, mode),
+                                blend_epu16_256(hi, s, sa, av, inv, mode));
+      }
+      _mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(r, opaque));
+    }
+  }
+#endif
+#if defined(__SSE2__)
+  {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i opaque = _mm_set1_epi32((int)0xFF000000u);
+    const __m128i s = _mm_unpacklo_epi8(_mm_set1_epi32((int)color), zero);
+    const __m128i av = _mm_set1_epi16((short)a);
+    const __m128i inv = _mm_set1_epi16((short)(255 - a));
+    const __m128i sa = _mm_mullo_epi16(s, av);
+    const __m128i sa8 = _mm_packus_epi16(div255_epu16(sa), div255_epu16(sa));
+    for (; i + 4 <= n; i += 4) {
+      __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+      __m128i r;
+      if (mode == FB_BLEND_ADD) {
+        r = _mm_adds_epu8(d, sa8);
+      } else {
+        __m128i lo = _mm_unpacklo_epi8(d, zero);
+        __m128i hi = _mm_unpackhi_epi8(d, zero);
+        r = _mm_packus_epi16(blend_epu16(lo, s, sa, av, inv, mode),
+                             blend_epu16(hi, s, sa, av, inv, mode));
+      }
+      _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(r, opaque));
+    }
+  }
+#endif
+  for (; i < n; i++)
+    dst[i] = blend_argb(dst[i], color, a, mode);
+}
+
+// Blend the current color into n consecutive pixels from buffer index idx.
+// Packed formats go through ARGB one pixel at a time.
+static void blend_native(Framebuffer *fb, size_t idx, int n) {
+  if (fb->bpp == 4) {
+    blend_pixels((Pixel *)fb->pixels + idx, fb->current_color,
+                 fb->blend_alpha, fb->blend, n);
+    return;
+  }
+  for (size_t i = idx; i < idx + (size_t)n; i++) {
+    Pixel d = fb_unpack_color(fb, pix_load(fb, i));
+    pix_store(fb, i,
+              fb_pack_color(fb, blend_argb(d, fb->current_color,
+                                           fb->blend_alpha, fb->blend)));
+  }
+}
+
+// ========== TEXTURES ==========
+
+int fb_tex_filter_from_name(const char *name) {
+  for (int f = 0; f < FB_TEX_FILTER_COUNT; f++) {
+    if (name && strcasecmp(name, tex_filter_names[f]) == 0)
+      return f;
+  }
+  return -1;
+}
+
+int fb_tex_bind(FbTexture *tex, const uint32_t *texels, int width,
+                int height, FbTexFilter filter) {
+  tex->texels = NULL;
+  if (!texels || width == 0 || height == 0)
+    return 0;
+  if (width < 0 || width > FB_TEX_MAX || (width & (width - 1)) ||
+      height < 0 || height > FB_TEX_MAX || (height & (height - 1)))
+    return -1;
+
+  tex->texels = texels;
+  tex->width = width;
+  tex->height = height;
+  tex->shift = __builtin_ctz((unsigned)width);
+  tex->filter = filter == FB_TEX_BILINEAR ? FB_TEX_BILINEAR : FB_TEX_NEAREST;
+  return 0;
+}
+
+void fb_tex_map(FbTexture *tex, int axis, int32_t c0, int32_t dx, int32_t dy) {
+  if (axis == 0) {
+    tex->u0 = c0, tex->dudx = dx, tex->dudy = dy;
+  } else {
+    tex->v0 = c0, tex->dvdx = dx, tex->dvdy = dy;
+  }
+}
+
+// Texel at integer coordinate (i, j), wrapped
+static inline uint32_t texel_at(const FbTexture *t, int32_t i, int32_t j) {
+  return t->texels[(uint32_t)(j & (t->height - 1)) << t->shift |
+                   (uint32_t)(i & (t->width - 1))];
+}
+
+// (a * (256 - f) + b * f) / 256, rounded, on each byte of a and b
+static inline uint32_t lerp_bytes(uint32_t a, uint32_t b, uint32_t f) {
+  uint32_t out = 0;
+  for (int shift = 0; shift < 32; shift += 8) {
+    uint32_t ac = (a >> shift) & 0xFF, bc = (b >> shift) & 0xFF;
+    out |= ((ac * (256 - f) + bc * f + 128) >> 8) << shift;
+  }
+  return out;
+}
+
+// Sample at (u, v) with FB_TEX_FRAC fraction bits. Bilinear coordinates
+// must already be moved half a texel back, onto texel centers.
+static inline uint32_t tex_fetch(const FbTexture *t, int32_t u, int32_t v) {
+  const uint32_t frac = (1u << FB_TEX_FRAC) - 1;
+  int32_t i = u >> FB_TEX_FRAC, j = v >> FB_TEX_FRAC;
+  if (t->filter == FB_TEX_NEAREST)
+    return texel_at(t, i, j);
+  uint32_t fu = (uint32_t)u & frac, fv = (uint32_t)v & frac;
+  uint32_t top = lerp_bytes(texel_at(t, i, j), texel_at(t, i + 1, j), fu);
+  uint32_t bot =
+      lerp_bytes(texel_at(t, i, j + 1), texel_at(t, i + 1, j + 1), fu);
+  return lerp_bytes(top, bot, fv);
+}
+
+uint32_t fb_tex_sample(const FbTexture *tex, int32_t u, int32_t v) {
+  if (!tex || !tex->texels)
+    return 0;
+  if (tex->filter == FB_TEX_BILINEAR) {
+    u -= 1 << (FB_TEX_FRAC - 1);
+    v -= 1 << (FB_TEX_FRAC - 1);
+  }
+  return tex_fetch(tex, u, v) & 0x00FFFFFF;
+}
+
+#if defined(__SSE2__)
+// Buffer indices of the texels at integer coordinates (i, j), four lanes
+static inline __m128i tex_index4(const FbTexture *t, __m128i i, __m128i j) {
+  i = _mm_and_si128(i, _mm_set1_epi32(t->width - 1));
+  j = _mm_and_si128(j, _mm_set1_epi32(t->height - 1));
+  return _mm_or_si128(_mm_sll_epi32(j, _mm_cvtsi32_si128(t->shift)), i);
+}
+
+static inline __m128i tex_gather4(const FbTexture *t, __m128i idx) {
+#if defined(__AVX2__)
+  return _mm_i32gather_epi32((const int *)t->texels, idx, 4);
+#else
+  uint32_t k[4];
+  _mm_storeu_si128((__m128i *)k, idx);
+  return _mm_setr_epi32((int)t->texels[k[0]], (int)t->texels[k[1]],
+                        (int)t->texels[k[2]], (int)t->texels[k[3]]);
+#endif
+}
+
+// lerp_bytes on 16-bit channels; every intermediate fits 16 bits unsigned
+static inline __m128i lerp_epu16(__m128i a, __m128i b, __m128i f) {
+  __m128i r = _mm_add_epi16(
+      _mm_mullo_epi16(a, _mm_sub_epi16(_mm_set1_epi16(256), f)),
+      _mm_mullo_epi16(b, f));
+  return _mm_srli_epi16(_mm_add_epi16(r, _mm_set1_epi16(128)), 8);
+}
+
+// Per-lane weights 0..255 spread over the four channels of lanes 0-1 (lo)
+// and 2-3 (hi)
+static inline void spread_weights(__m128i f, __m128i *lo, __m128i *hi) {
+  __m128i f16 = _mm_packs_epi32(f, f);
+  f16 = _mm_unpacklo_epi16(f16, f16);
+  *lo = _mm_unpacklo_epi32(f16, f16);
+  *hi = _mm_unpackhi_epi32(f16, f16);
+}
+
+// Bilinear filter of two pixels' texel quads (widened to 16 bits)
+static inline __m128i bilerp2(__m128i t00, __m128i t10, __m128i t01,
+                              __m128i t11, __m128i fu, __m128i fv) {
+  return lerp_epu16(lerp_epu16(t00, t10, fu), lerp_epu16(t01, t11, fu), fv);
+}
+#endif
+
+// Opaque texels for n pixels of a span starting at texel coordinate (u, v)
+// and stepping (du, dv) per pixel. Coordinates step as 32-bit lanes in
+// fixed point; texels are fetched four at a time (gathered with AVX2).
+static void tex_span(const FbTexture *t, uint32_t u, uint32_t v, int32_t du,
+                     int32_t dv, int n, Pixel *out) {
+  if (t->filter == FB_TEX_BILINEAR) {
+    u -= 1u << (FB_TEX_FRAC - 1);
+    v -= 1u << (FB_TEX_FRAC - 1);
+  }
+
+  int i = 0;
+#if defined(__SSE2__)
+  if (n >= 4) {
+    const __m128i opaque = _mm_set1_epi32((int)0xFF000000u);
+    const __m128i frac = _mm_set1_epi32((1 << FB_TEX_FRAC) - 1);
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i su = _mm_set1_epi32((int)(4u * (uint32_t)du));
+    const __m128i sv = _mm_set1_epi32((int)(4u * (uint32_t)dv));
+    __m128i uu = _mm_setr_epi32((int)u, (int)(u + (uint32_t)du),
+                                (int)(u + 2u * (uint32_t)du),
+                                (int)(u + 3u * (uint32_t)du));
+    __m128i vv = _mm_setr_epi32((int)v, (int)(v + (uint32_t)dv),
+                                (int)(v + 2u * (uint32_t)dv),
+                                (int)(v + 3u * (uint32_t)dv));
+    for (; i + 4 <= n; i += 4) {
+      __m128i ti = _mm_srai_epi32(uu, FB_TEX_FRAC);
+      __m128i tj = _mm_srai_epi32(vv, FB_TEX_FRAC);
+      __m128i px;
+      if (t->filter == FB_TEX_NEAREST) {
+        px = tex_gather4(t, tex_index4(t, ti, tj));
+      } else {
+        __m128i ti1 = _mm_add_epi32(ti, one), tj1 = _mm_add_epi32(tj, one);
+        __m128i t00 = tex_gather4(t, tex_index4(t, ti, tj));
+        __m128i t10 = tex_gather4(t, tex_index4(t, ti1, tj));
+        __m128i t01 = tex_gather4(t, tex_index4(t, ti, tj1));
+        __m128i t11 = tex_gather4(t, tex_index4(t, ti1, tj1));
+        __m128i fu_lo, fu_hi, fv_lo, fv_hi;
+        spread_weights(_mm_and_si128(uu, frac), &fu_lo, &fu_hi);
+        spread_weights(_mm_and_si128(vv, frac), &fv_lo, &fv_hi);
+        __m128i lo = bilerp2(
+            _mm_unpacklo_epi8(t00, zero), _mm_unpacklo_epi8(t10, zero),
+            _mm_unpacklo_epi8(t01, zero), _mm_unpacklo_epi8(t11, zero),
+            fu_lo, fv_lo);
+        __m128i hi = bilerp2(
+            _mm_unpackhi_epi8(t00, zero), _mm_unpackhi_epi8(t10, zero),
+            _mm_unpackhi_epi8(t01, zero), _mm_unpackhi_epi8(t11, zero),
+            fu_hi, fv_hi);
+        px = _mm_packus_epi16(lo, hi);
+      }
+      _mm_storeu_si128((__m128i *)(out + i), _mm_or_si128(px, opaque));
+      uu = _mm_add_epi32(uu, su);
+      vv = _mm_add_epi32(vv, sv);
+    }
+    u += (uint32_t)i * (uint32_t)du;
+    v += (uint32_t)i * (uint32_t)dv;
+  }
+#endif
+  for (; i < n; i++, u += (uint32_t)du, v += (uint32_t)dv)
+    out[i] = tex_fetch(t, (int32_t)u, (int32_t)v) | 0xFF000000u;
 }
 
-// Bresenham line drawing algorithm
+// ========== SPAN KERNELS ==========
+
+// Store a 32-bit value into n consecutive pixels
+static void fill_pixels(Pixel *dst, Pixel color, int n) {
+  int i = 0;
+#if defined(__AVX2__)
+  __m256i v = _mm256_set1_epi32((int)color);
+  for (; i + 8 <= n; i += 8)
+    _mm256_storeu_si256((__m256i *)(dst + i), v);
+#elif defined(__SSE2__)
+  __m128i v = _mm_set1_epi32((int)color);
+  for (; i + 8 <= n; i += 8) {
+    _mm_storeu_si128((__m128i *)(dst + i), v);
+    _mm_storeu_si128((__m128i *)(dst + i + 4), v);
+  }
+#endif
+  for (; i < n; i++)
+    dst[i] = color;
+}
+
+// Store a 16-bit value into n consecutive pixels
+static void fill_pixels16(uint16_t *dst, uint16_t color, int n) {
+  int i = 0;
+#if defined(__AVX2__)
+  __m256i v = _mm256_set1_epi16((short)color);
+  for (; i + 16 <= n; i += 16)
+    _mm256_storeu_si256((__m256i *)(dst + i), v);
+#elif defined(__SSE2__)
+  __m128i v = _mm_set1_epi16((short)color);
+  for (; i + 8 <= n; i += 8)
+    _mm_storeu_si128((__m128i *)(dst + i), v);
+#endif
+  for (; i < n; i++)
+    dst[i] = color;
+}
+
+// Store the current color into n consecutive pixels from buffer index idx
+static void fill_native(Framebuffer *fb, size_t idx, int n) {
+  if (fb->blend != FB_BLEND_NONE) {
+    blend_native(fb, idx, n);
+    return;
+  }
+  switch (fb->bpp) {
+  case 4:
+    fill_pixels((Pixel *)fb->pixels + idx, fb->native_color, n);
+    break;
+  case 2:
+    fill_pixels16((uint16_t *)fb->pixels + idx, (uint16_t)fb->native_color, n);
+    break;
+  default:
+    memset((uint8_t *)fb->pixels + idx, (int)fb->native_color, (size_t)n);
+    break;
+  }
+}
+
+#if defined(__SSE2__)
+// Per lane: m ? a : b
+static inline __m128i select128(__m128i m, __m128i a, __m128i b) {
+  return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b));
+}
+#endif
+
+// Depth-tested fill of n pixels against a 16-bit depth row
+static int fill_pixels_z16(Pixel *dst, uint16_t *zrow, Pixel color,
+                           uint16_t z, int n) {
+  int i = 0, written = 0;
+#if defined(__SSE2__)
+  // Unsigned compare via signed compare on values biased by 0x8000
+  const __m128i bias = _mm_set1_epi16((short)0x8000);
+  const __m128i zv = _mm_set1_epi16((short)z);
+  const __m128i zb = _mm_xor_si128(zv, bias);
+  const __m128i cv = _mm_set1_epi32((int)color);
+  for (; i + 8 <= n; i += 8) {
+    __m128i old = _mm_loadu_si128((const __m128i *)(zrow + i));
+    __m128i pass = _mm_cmpgt_epi16(_mm_xor_si128(old, bias), zb);
+    int bits = _mm_movemask_epi8(pass);
+    if (!bits)
+      continue;
+    _mm_storeu_si128((__m128i *)(zrow + i), select128(pass, zv, old));
+    __m128i lo = _mm_unpacklo_epi16(pass, pass);
+    __m128i hi = _mm_unpackhi_epi16(pass, pass);
+    __m128i *p = (__m128i *)(dst + i);
+    _mm_storeu_si128(p, select128(lo, cv, _mm_loadu_si128(p)));
+    _mm_storeu_si128(p + 1, select128(hi, cv, _mm_loadu_si128(p + 1)));
+    written += __builtin_popcount(bits) / 2;
+  }
+#endif
+  for (; i < n; i++) {
+    if (z < zrow[i]) {
+      zrow[i] = z;
+      dst[i] = color;
+      written++;
+    }
+  }
+  return written;
+}
+
+// Depth-tested fill of n pixels against a 32-bit depth row
+static int fill_pixels_z32(Pixel *dst, uint32_t *zrow, Pixel color,
+                           uint32_t z, int n) {
+  int i = 0, written = 0;
+#if defined(__SSE2__)
+  const __m128i bias = _mm_set1_epi32((int)0x80000000u);
+  const __m128i zv = _mm_set1_epi32((int)z);
+  const __m128i zb = _mm_xor_si128(zv, bias);
+  const __m128i cv = _mm_set1_epi32((int)color);
+  for (; i + 4 <= n; i += 4) {
+    __m128i old = _mm_loadu_si128((const __m128i *)(zrow + i));
+    __m128i pass = _mm_cmpgt_epi32(_mm_xor_si128(old, bias), zb);
+    int bits = _mm_movemask_ps(_mm_castsi128_ps(pass));
+    if (!bits)
+      continue;
+    _mm_storeu_si128((__m128i *)(zrow + i), select128(pass, zv, old));
+    __m128i *p = (__m128i *)(dst + i);
+    _mm_storeu_si128(p, select128(pass, cv, _mm_loadu_si128(p)));
+    written += __builtin_popcount(bits);
+  }
+#endif
+  for (; i < n; i++) {
+    if (z < zrow[i]) {
+      zrow[i] = z;
+      dst[i] = color;
+      written++;
+    }
+  }
+  return written;
+}
+
+// Depth test of buffer index idx at the current z, updating the depth
+// buffer on a pass (always passes with the test off)
+static inline int depth_pass(Framebuffer *fb, size_t idx) {
+  if (fb->depth && fb->depth_test) {
+    if (fb->depth_bits == 16) {
+      uint16_t *zp = (uint16_t *)fb->depth + idx;
+      uint16_t z = fb->current_z > 0xFFFF ? 0xFFFF : (uint16_t)fb->current_z;
+      if (z >= *zp)
+        return 0;
+      *zp = z;
+    } else {
+      uint32_t *zp = (uint32_t *)fb->depth + idx;
+      if (fb->current_z >= *zp)
+        return 0;
+      *zp = fb->current_z;
+    }
+  }
+  return 1;
+}
+
+// Single-pixel depth-tested draw of the current color (no bounds checks)
+static inline int plot(Framebuffer *fb, size_t idx) {
+  if (!depth_pass(fb, idx))
+    return 0;
+  draw_at(fb, idx);
+  return 1;
+}
+
+// Fill n consecutive buffer pixels from index idx with the current color,
+// depth-tested when enabled; returns the pixels actually written
+static int fill_seg(Framebuffer *fb, size_t idx, int n) {
+  if (!fb->depth || !fb->depth_test) {
+    fill_native(fb, idx, n);
+    return n;
+  }
+  if (fb->bpp != 4 || fb->blend != FB_BLEND_NONE) {
+    // The SIMD depth kernels store 32-bit pixels unblended
+    int written = 0;
+    for (int i = 0; i < n; i++)
+      written += plot(fb, idx + i);
+    return written;
+  }
+  Pixel *dst = (Pixel *)fb->pixels + idx;
+  if (fb->depth_bits == 16) {
+    uint16_t z = fb->current_z > 0xFFFF ? 0xFFFF : (uint16_t)fb->current_z;
+    return fill_pixels_z16(dst, (uint16_t *)fb->depth + idx, fb->native_color,
+                           z, n);
+  }
+  return fill_pixels_z32(dst, (uint32_t *)fb->depth + idx, fb->native_color,
+                         fb->current_z, n);
+}
+
+// Depth-tested fill of pixels x .. x + n - 1 of row y (no bounds checks)
+static int fill_run(Framebuffer *fb, int x, int y, int n) {
+  if (fb->layout == FB_LAYOUT_LINEAR)
+    return fill_seg(fb, pix_index(fb, x, y), n);
+
+  int written = 0;
+  while (n > 0) {
+    int len = run_length(fb, x, n);
+    written += fill_seg(fb, pix_index(fb, x, y), len);
+    x += len;
+    n -= len;
+  }
+  return written;
+}
+
+#define TEX_CHUNK 64
+
+// Textured version of fill_run: texels replace the current color, then
+// go through the depth test and blending like it
+static int tex_run(Framebuffer *fb, int x, int y, int n) {
+  const FbTexture *t = &fb->tex;
+  uint32_t u = (uint32_t)t->u0 + (uint32_t)x * (uint32_t)t->dudx +
+               (uint32_t)y * (uint32_t)t->dudy;
+  uint32_t v = (uint32_t)t->v0 + (uint32_t)x * (uint32_t)t->dvdx +
+               (uint32_t)y * (uint32_t)t->dvdy;
+  int direct = fb->bpp == 4 && fb->blend == FB_BLEND_NONE &&
+               !(fb->depth && fb->depth_test);
+  Pixel texels[TEX_CHUNK];
+  int written = 0;
+
+  while (n > 0) {
+    int chunk = n < TEX_CHUNK ? n : TEX_CHUNK;
+    tex_span(t, u, v, t->dudx, t->dvdx, chunk, texels);
+    u += (uint32_t)chunk * (uint32_t)t->dudx;
+    v += (uint32_t)chunk * (uint32_t)t->dvdx;
+
+    for (int i = 0; i < chunk;) {
+      int len = run_length(fb, x + i, chunk - i);
+      size_t idx = pix_index(fb, x + i, y);
+      if (direct) {
+        memcpy((Pixel *)fb->pixels + idx, texels + i, (size_t)len * 4);
+        written += len;
+      } else {
+        for (int k = 0; k < len; k++) {
+          if (!depth_pass(fb, idx + k))
+            continue;
+          Pixel c = texels[i + k];
+          if (fb->blend != FB_BLEND_NONE)
+            c = blend_argb(fb_unpack_color(fb, pix_load(fb, idx + k)), c,
+                           fb->blend_alpha, fb->blend);
+          pix_store(fb, idx + k, fb_pack_color(fb, c));
+          written++;
+        }
+      }
+      i += len;
+    }
+    x += chunk;
+    n -= chunk;
+  }
+  return written;
+}
+
+// Set pixel at (x, y), depth-tested at the current z when enabled (DRAWPIXZ)
+void fb_set_pixel_z(Framebuffer *fb, int x, int y, Pixel color) {
+  if (!fb || !fb->pixels)
+    return;
+  if (x < fb->clip_x0 || x >= fb->clip_x1 || y < fb->clip_y0 ||
+      y >= fb->clip_y1)
+    return;
+
+  Pixel current = fb->current_color;
+  if (color != current)
+    fb_set_color(fb, color);
+  if (plot(fb, pix_index(fb, x, y))) {
+    mark_pixel(fb, x, y);
+    fb->pixels_written++;
+  }
+  if (color != current)
+    fb_set_color(fb, current);
+}
+
+// Fill pixels x0..x1 (inclusive, any order) of row y with the current color
+void fb_fill_span(Framebuffer *fb, int x0, int x1, int y) {
+  fb_fill_rect(fb, x0, y, x1, y);
+}
+
+// Fill the rectangle with inclusive corners (x0, y0), (x1, y1) with the
+// current color. Clipped once up front, then whole rows are stored.
+void fb_fill_rect(Framebuffer *fb, int x0, int y0, int x1, int y1) {
+  if (!fb || !fb->pixels)
+    return;
+
+  if (fb_clip_rect(fb, &x0, &y0, &x1, &y1) == 0)
+    return;
+
+  uint64_t written = 0;
+  for (int y = y0; y < y1; y++)
+    written += fb->tex.texels ? tex_run(fb, x0, y, x1 - x0)
+                              : fill_run(fb, x0, y, x1 - x0);
+  if (written)
+    mark_rect(fb, x0, y0, x1, y1);
+  fb->pixels_written += written;
+}
+
+// ========== LINES ==========
+
+// Step range of a Bresenham line that stays inside the clip rectangle.
+// The line runs n = max(dx, dy) steps. Step k is at major offset k and minor
+// offset m(k) = (2*k*d + D - 1) / (2*D) (D major delta, d minor delta),
+// which is exactly where the error-term loop in fb_draw_line puts it, so
+// the clipped line draws the same pixels as the unclipped one.
+
+// First step whose minor offset is >= t (n + 1 if none)
+static int64_t line_first_step(int64_t t, int64_t D, int64_t d, int64_t n) {
+  if (t <= 0)
+    return 0;
+  if (d == 0)
+    return n + 1;
+  return (2 * D * t - D + 1 + 2 * d - 1) / (2 * d);
+}
+
+// Last step whose minor offset is <= t (-1 if none)
+static int64_t line_last_step(int64_t t, int64_t D, int64_t d, int64_t n) {
+  if (t < 0)
+    return -1;
+  if (d == 0)
+    return n;
+  return (2 * D * t + D) / (2 * d);
+}
+
+// Steps k0..k1 of the line from (x1, y1) to (x2, y2) that stay inside the
+// clip rectangle; k0 > k1 when none do
+static void line_clip_steps(const Framebuffer *fb, int x1, int y1, int x2,
+                            int y2, int64_t *k0, int64_t *k1) {
+  int64_t dx = llabs((int64_t)x2 - x1);
+  int64_t dy = llabs((int64_t)y2 - y1);
+  int x_major = dx >= dy;
+  int64_t D = x_major ? dx : dy, d = x_major ? dy : dx, n = D;
+  int maj1 = x_major ? x1 : y1, min1 = x_major ? y1 : x1;
+  int smaj = x_major ? (x1 < x2 ? 1 : -1) : (y1 < y2 ? 1 : -1);
+  int smin = x_major ? (y1 < y2 ? 1 : -1) : (x1 < x2 ? 1 : -1);
+  int maj_lo = x_major ? fb->clip_x0 : fb->clip_y0;
+  int maj_hi = x_major ? fb->clip_x1 : fb->clip_y1;
+  int min_lo = x_major ? fb->clip_y0 : fb->clip_x0;
+  int min_hi = x_major ? fb->clip_y1 : fb->clip_x1;
+
+  // Major axis: linear in k
+  if (smaj > 0) {
+    *k0 = maj_lo - (int64_t)maj1;
+    *k1 = maj_hi - 1 - (int64_t)maj1;
+  } else {
+    *k0 = maj1 - (int64_t)(maj_hi - 1);
+    *k1 = maj1 - (int64_t)maj_lo;
+  }
+  if (*k0 < 0)
+    *k0 = 0;
+  if (*k1 > n)
+    *k1 = n;
+
+  // Minor axis: monotone in k
+  int64_t m_lo = smin > 0 ? min_lo - (int64_t)min1 : min1 - (int64_t)(min_hi - 1);
+  int64_t m_hi = smin > 0 ? min_hi - 1 - (int64_t)min1 : min1 - (int64_t)min_lo;
+  int64_t f = line_first_step(m_lo, D, d, n);
+  int64_t l = line_last_step(m_hi, D, d, n);
+  if (f > *k0)
+    *k0 = f;
+  if (l < *k1)
+    *k1 = l;
+}
+
+uint32_t fb_line_pixels(const Framebuffer *fb, int x1, int y1, int x2,
+                        int y2) {
+  int64_t k0, k1;
+  line_clip_steps(fb, x1, y1, x2, y2, &k0, &k1);
+  return k0 > k1 ? 0 : (uint32_t)(k1 - k0 + 1);
+}
+
+// Mark the tiles under steps k0..k1 of a line (see above). Each chunk of
+// FB_DIRTY_TILE steps spans at most 2x2 tiles, so its endpoints' box is
+// a tight bound.
+static void mark_line(Framebuffer *fb, int x_major, int maj1, int min1,
+                      int smaj, int smin, int64_t D, int64_t d, int64_t k0,
+                      int64_t k1) {
+  for (int64_t ka = k0; ka <= k1; ka += FB_DIRTY_TILE) {
+    int64_t kb = ka + FB_DIRTY_TILE - 1 < k1 ? ka + FB_DIRTY_TILE - 1 : k1;
+    int64_t ma = (D == 0) ? 0 : (2 * ka * d + D - 1) / (2 * D);
+    int64_t mb = (D == 0) ? 0 : (2 * kb * d + D - 1) / (2 * D);
+    int a_maj = (int)(maj1 + smaj * ka), b_maj = (int)(maj1 + smaj * kb);
+    int a_min = (int)(min1 + smin * ma), b_min = (int)(min1 + smin * mb);
+    int lo_maj = a_maj < b_maj ? a_maj : b_maj;
+    int hi_maj = (a_maj < b_maj ? b_maj : a_maj) + 1;
+    int lo_min = a_min < b_min ? a_min : b_min;
+    int hi_min = (a_min < b_min ? b_min : a_min) + 1;
+    if (x_major)
+      mark_rect(fb, lo_maj, lo_min, hi_maj, hi_min);
+    else
+      mark_rect(fb, lo_min, lo_maj, hi_min, hi_maj);
+  }
+}
+
+// Bresenham line drawing algorithm, clipped up front to the writable region
+// so the inner loops store pixels without per-pixel checks.
+// Horizontal, vertical and diagonal lines take dedicated loops.
 void fb_draw_line(Framebuffer *fb, int x1, int y1, int x2, int y2) {
-  if (!fb)
+  if (!fb || !fb->pixels)
     return;
 
-  int dx = abs(x2 - x1);
-  int dy = abs(y2 - y1);
+  int64_t dx = llabs((int64_t)x2 - x1);
+  int64_t dy = llabs((int64_t)y2 - y1);
   int sx = (x1 < x2) ? 1 : -1;
   int sy = (y1 < y2) ? 1 : -1;
-  int err = dx - dy;
 
-  int x = x1, y = y1;
+  // Major axis steps every iteration (x on ties)
+  int x_major = dx >= dy;
+  int64_t D = x_major ? dx : dy, d = x_major ? dy : dx;
+  int maj1 = x_major ? x1 : y1, min1 = x_major ? y1 : x1;
+  int smaj = x_major ? sx : sy, smin = x_major ? sy : sx;
 
-  while (1) {
-    fb_set_pixel(fb, x, y, fb->current_color);
+  int64_t k0, k1;
+  line_clip_steps(fb, x1, y1, x2, y2, &k0, &k1);
+  if (k0 > k1)
+    return;
 
-    if (x == x2 && y == y2)
-      break;
+  // Position and error term at step k0
+  int64_t m0 = (D == 0) ? 0 : (2 * k0 * d + D - 1) / (2 * D);
+  int x = (int)(x_major ? x1 + sx * k0 : x1 + sx * m0);
+  int y = (int)(x_major ? y1 + sy * m0 : y1 + sy * k0);
+  int count = (int)(k1 - k0 + 1);
+  size_t idx = pix_index(fb, x, y);
+  mark_line(fb, x_major, maj1, min1, smaj, smin, D, d, k0, k1);
 
-    int e2 = 2 * err;
-    if (e2 > -dy) {
-      err -= dy;
-      x += sx;
+  if (dy == 0) {
+    int left = sx > 0 ? x : x - (count - 1);
+    for (int n = count; n > 0;) {
+      int len = run_length(fb, left, n);
+      fill_native(fb, pix_index(fb, left, y), len);
+      left += len;
+      n -= len;
     }
-    if (e2 < dx) {
-      err += dx;
-      y += sy;
+  } else if (fb->layout == FB_LAYOUT_LINEAR && (dx == 0 || dx == dy)) {
+    ptrdiff_t stride = (ptrdiff_t)sy * fb->width + (dx == 0 ? 0 : sx);
+    for (int i = 0; i < count; i++, idx += stride)
+      draw_at(fb, idx);
+  } else if (fb->layout == FB_LAYOUT_LINEAR) {
+    int64_t ax = x_major ? k0 : m0, ay = x_major ? m0 : k0;
+    int64_t err = dx - dy - ax * dy + ay * dx;
+    ptrdiff_t step_x = sx, step_y = (ptrdiff_t)sy * fb->width;
+    for (int i = 0; i < count; i++) {
+      draw_at(fb, idx);
+      int64_t e2 = 2 * err;
+      if (e2 > -dy) {
+        err -= dy;
+        idx += step_x;
+      }
+      if (e2 < dx) {
+        err += dx;
+        idx += step_y;
+      }
+    }
+  } else {
+    // Tiled: a buffer step depends on tile crossings, so step coordinates
+    int64_t ax = x_major ? k0 : m0, ay = x_major ? m0 : k0;
+    int64_t err = dx - dy - ax * dy + ay * dx;
+    for (int i = 0; i < count; i++) {
+      draw_at(fb, pix_index(fb, x, y));
+      int64_t e2 = 2 * err;
+      if (e2 > -dy) {
+        err -= dy;
+        x += sx;
+      }
+      if (e2 < dx) {
+        err += dx;
+        y += sy;
+      }
     }
   }
+  fb->pixels_written += count;
 }
 
-// Draw line from current position by (dx, dy) offset
-void fb_draw_step(Framebuffer *fb, int dx, int dy) {
-  if (!fb)
+// ========== TRIANGLE RASTERIZER ==========
+
+#define TRI_TILE FB_TILE // raster tiles match the tiled layout
+
+// Half-space edge function E(x, y) = a*x + b*y + c; a pixel is inside
+// the triangle when E >= 0 for all three edges
+typedef struct {
+  int32_t a, b, c;
+} TriEdge;
+
+// Edge from (ax, ay) to (bx, by). Pixels exactly on the edge belong to it
+// only if it is a top or left edge, so triangles sharing an edge never
+// both draw (or both miss) the pixels on it.
+static TriEdge tri_edge(int ax, int ay, int bx, int by) {
+  TriEdge e = {.a = ay - by, .b = bx - ax};
+  int top_left = (by < ay) || (by == ay && bx > ax);
+  e.c = (by - ay) * ax - (bx - ax) * ay - (top_left ? 0 : 1);
+  return e;
+}
+
+static inline int32_t tri_eval(const TriEdge *e, int x, int y) {
+  return e->a * x + e->b * y + e->c;
+}
+
+// Bit i set if pixel (x + i, y) is inside, for i in 0..7
+static uint32_t tri_row_mask(const TriEdge e[3], int x, int y) {
+#if defined(__AVX2__)
+  const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  __m256i out = _mm256_setzero_si256();
+  for (int k = 0; k < 3; k++) {
+    __m256i v = _mm256_add_epi32(_mm256_set1_epi32(tri_eval(&e[k], x, y)),
+                                 _mm256_mullo_epi32(lane, _mm256_set1_epi32(e[k].a)));
+    out = _mm256_or_si256(out, v);
+  }
+  return ~(uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(out)) & 0xFF;
+#elif defined(__SSE2__)
+  __m128i out_lo = _mm_setzero_si128(), out_hi = _mm_setzero_si128();
+  for (int k = 0; k < 3; k++) {
+    int32_t e0 = tri_eval(&e[k], x, y), a = e[k].a;
+    __m128i lo = _mm_setr_epi32(e0, e0 + a, e0 + 2 * a, e0 + 3 * a);
+    out_lo = _mm_or_si128(out_lo, lo);
+    out_hi = _mm_or_si128(out_hi, _mm_add_epi32(lo, _mm_set1_epi32(4 * a)));
+  }
+  // Sign bit set in any edge = outside
+  uint32_t outside = (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(out_lo)) |
+                     (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(out_hi)) << 4;
+  return ~outside & 0xFF;
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < TRI_TILE; i++) {
+    if ((tri_eval(&e[0], x + i, y) | tri_eval(&e[1], x + i, y) |
+         tri_eval(&e[2], x + i, y)) >= 0)
+      mask |= 1u << i;
+  }
+  return mask;
+#endif
+}
+
+// Fill a triangle with the current color. The clipped bounding box is
+// walked in 8x8 tiles: a tile entirely outside one edge is skipped, a tile
+// entirely inside all three is filled row by row, and only tiles crossing
+// an edge are tested per pixel, eight at a time.
+void fb_fill_triangle(Framebuffer *fb, int x0, int y0, int x1, int y1, int x2,
+                      int y2) {
+  if (!fb || !fb->pixels)
     return;
 
-  int x2 = fb->draw_x + dx;
-  int y2 = fb->draw_y + dy;
+  int xs[3] = {x0, x1, x2}, ys[3] = {y0, y1, y2};
+  for (int k = 0; k < 3; k++) {
+    if (abs(xs[k]) > TRI_GUARD_BAND || abs(ys[k]) > TRI_GUARD_BAND)
+      return;
+  }
 
-  fb_draw_line(fb, fb->draw_x, fb->draw_y, x2, y2);
+  // Make the winding positive so "inside" is E >= 0 on every edge
+  int64_t area2 = (int64_t)(x1 - x0) * (y2 - y0) - (int64_t)(y1 - y0) * (x2 - x0);
+  if (area2 == 0)
+    return;
+  if (area2 < 0) {
+    int t = x1;
+    x1 = x2, x2 = t;
+    t = y1;
+    y1 = y2, y2 = t;
+  }
+  TriEdge e[3] = {tri_edge(x0, y0, x1, y1), tri_edge(x1, y1, x2, y2),
+                  tri_edge(x2, y2, x0, y0)};
 
-  fb->draw_x = x2;
-  fb->draw_y = y2;
+  int bx0 = x0 < x1 ? (x0 < x2 ? x0 : x2) : (x1 < x2 ? x1 : x2);
+  int by0 = y0 < y1 ? (y0 < y2 ? y0 : y2) : (y1 < y2 ? y1 : y2);
+  int bx1 = x0 > x1 ? (x0 > x2 ? x0 : x2) : (x1 > x2 ? x1 : x2);
+  int by1 = y0 > y1 ? (y0 > y2 ? y0 : y2) : (y1 > y2 ? y1 : y2);
+  if (fb_clip_rect(fb, &bx0, &by0, &bx1, &by1) == 0)
+    return;
+
+  uint64_t written = 0;
+
+  // Tiles sit on the 8x8 grid, so in the tiled layout each tile row is one
+  // run of consecutive pixels
+  for (int gy = by0 - by0 % TRI_TILE; gy < by1; gy += TRI_TILE) {
+    int ty = gy > by0 ? gy : by0;
+    int ty1 = gy + TRI_TILE < by1 ? gy + TRI_TILE : by1;
+    for (int gx = bx0 - bx0 % TRI_TILE; gx < bx1; gx += TRI_TILE) {
+      int tx = gx > bx0 ? gx : bx0;
+      int tx1 = gx + TRI_TILE < bx1 ? gx + TRI_TILE : bx1;
+
+      // Classify the tile by its corners (E is linear)
+      int accept = 1, reject = 0;
+      for (int k = 0; k < 3 && !reject; k++) {
+        int32_t c00 = tri_eval(&e[k], tx, ty);
+        int32_t c10 = tri_eval(&e[k], tx1 - 1, ty);
+        int32_t c01 = tri_eval(&e[k], tx, ty1 - 1);
+        int32_t c11 = tri_eval(&e[k], tx1 - 1, ty1 - 1);
+        if ((c00 & c10 & c01 & c11) < 0)
+          reject = 1;
+        else if ((c00 | c10 | c01 | c11) < 0)
+          accept = 0;
+      }
+      if (reject)
+        continue;
+      mark_rect(fb, tx, ty, tx1, ty1);
+
+      int w = tx1 - tx;
+      for (int y = ty; y < ty1; y++) {
+        if (fb->tex.texels) {
+          // Textured: one run per stretch of covered pixels
+          uint32_t m = accept ? (1u << w) - 1
+                              : tri_row_mask(e, tx, y) & ((1u << w) - 1);
+          while (m) {
+            int s = __builtin_ctz(m);
+            int len = __builtin_ctz(~(m >> s));
+            written += tex_run(fb, tx + s, y, len);
+            m &= ~(((1u << len) - 1) << s);
+          }
+          continue;
+        }
+
+        size_t row = pix_index(fb, tx, y);
+        if (accept) {
+          written += fill_seg(fb, row, w);
+          continue;
+        }
+
+        uint32_t mask = tri_row_mask(e, tx, y) & ((1u << w) - 1);
+        if (mask == 0xFF) {
+          written += fill_seg(fb, row, TRI_TILE);
+        } else {
+          for (uint32_t m = mask; m; m &= m - 1)
+            written += plot(fb, row + __builtin_ctz(m));
+        }
+      }
+    }
+  }
+
+  fb->pixels_written += written;
+}
+
+// ========== BLIT ==========
+
+// Copy n 0x00RRGGBB words into ARGB8888 pixels, made opaque. With use_key,
+// words whose RGB equals key keep the destination. Returns pixels written.
+static int blit_pixels(Pixel *dst, const uint32_t *src, int n, int use_key,
+                       Pixel key) {
+  int i = 0, written = 0;
+#if defined(__SSE2__)
+  const __m128i opaque = _mm_set1_epi32((int)0xFF000000u);
+  const __m128i rgb = _mm_set1_epi32(0x00FFFFFF);
+  const __m128i kv = _mm_set1_epi32((int)(key & 0x00FFFFFF));
+  for (; i + 4 <= n; i += 4) {
+    __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+    __m128i px = _mm_or_si128(s, opaque);
+    if (use_key) {
+      __m128i hit = _mm_cmpeq_epi32(_mm_and_si128(s, rgb), kv);
+      int bits = _mm_movemask_ps(_mm_castsi128_ps(hit));
+      if (bits == 0xF)
+        continue;
+      px = select128(hit, _mm_loadu_si128((const __m128i *)(dst + i)), px);
+      written += 4 - __builtin_popcount(bits);
+    } else {
+      written += 4;
+    }
+    _mm_storeu_si128((__m128i *)(dst + i), px);
+  }
+#endif
+  for (; i < n; i++) {
+    if (use_key && ((src[i] ^ key) & 0x00FFFFFF) == 0)
+      continue;
+    dst[i] = src[i] | 0xFF000000u;
+    written++;
+  }
+  return written;
+}
+
+uint64_t fb_blit(Framebuffer *fb, int x, int y, int w, int h,
+                 const uint32_t *src, int stride, int use_key) {
+  if (!fb || !fb->pixels || !src || w <= 0 || h <= 0)
+    return 0;
+
+  int x0 = x, y0 = y, x1 = x + w - 1, y1 = y + h - 1;
+  if (fb_clip_rect(fb, &x0, &y0, &x1, &y1) == 0)
+    return 0;
+
+  Pixel key = fb->current_color;
+  uint64_t written = 0;
+  for (int py = y0; py < y1; py++) {
+    const uint32_t *s = src + (size_t)(py - y) * stride + (x0 - x);
+    for (int px = x0; px < x1;) {
+      int len = run_length(fb, px, x1 - px);
+      size_t idx = pix_index(fb, px, py);
+      if (fb->bpp == 4) {
+        written += blit_pixels((Pixel *)fb->pixels + idx, s, len, use_key, key);
+      } else {
+        for (int i = 0; i < len; i++) {
+          if (use_key && ((s[i] ^ key) & 0x00FFFFFF) == 0)
+            continue;
+          pix_store(fb, idx + i, fb_pack_color(fb, s[i] | 0xFF000000u));
+          written++;
+        }
+      }
+      s += len;
+      px += len;
+    }
+  }
+
+  if (written)
+    mark_rect(fb, x0, y0, x1, y1);
+  fb->pixels_written += written;
+  return written;
 }
 
 // Create color from RGB components
@@ -134,35 +1620,200 @@ Pixel fb_color_argb(uint8_t a, uint8_t r, uint8_t g, uint8_t b) {
   return (a << 24) | (r << 16) | (g << 8) | b;
 }
 
-// Dump framebuffer as PPM (Portable PixMap) file
-void fb_dump_ppm(Framebuffer *fb, const char *filename) {
-  if (!fb || !fb->pixels)
-    return;
+// Any tile under [x0, x1) x [y0, y1) that may hold non-black pixels
+static int rect_has_ink(const Framebuffer *fb, int x0, int y0, int x1,
+                        int y1) {
+  for (int ty = y0 / FB_DIRTY_TILE; ty <= (y1 - 1) / FB_DIRTY_TILE; ty++) {
+    for (int tx = x0 / FB_DIRTY_TILE; tx <= (x1 - 1) / FB_DIRTY_TILE; tx++) {
+      if (tile_state(fb, tx, ty) & FB_DIRTY_INK)
+        return 1;
+    }
+  }
+  return 0;
+}
+
+#if defined(__SSSE3__)
+// Byte shuffle taking four ARGB pixels to 12 bytes of RGB (per 128-bit lane)
+static const int8_t rgb_shuffle[32] = {
+    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1, //
+    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1};
+#endif
+
+// ARGB8888 -> packed 8-bit RGB. The vector loops store a few bytes past
+// the pixels they convert, so they stop while those still fall inside
+// `out`; the next iteration or the scalar tail overwrites them.
+static void argb_to_rgb(const Pixel *src, int n, uint8_t *out) {
+  int i = 0;
+#if defined(__AVX2__)
+  if (n >= 11) {
+    const __m256i shuf8 = _mm256_loadu_si256((const __m256i *)rgb_shuffle);
+    const __m256i pack = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+    for (; i + 11 <= n; i += 8) {
+      __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+      v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, shuf8), pack);
+      _mm256_storeu_si256((__m256i *)(out + 3 * i), v);
+    }
+  }
+#endif
+#if defined(__SSSE3__)
+  const __m128i shuf4 = _mm_loadu_si128((const __m128i *)rgb_shuffle);
+  for (; i + 6 <= n; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+    _mm_storeu_si128((__m128i *)(out + 3 * i), _mm_shuffle_epi8(v, shuf4));
+  }
+#endif
+  for (; i < n; i++) {
+    Pixel p = src[i];
+    out[3 * i] = (p >> 16) & 0xFF;
+    out[3 * i + 1] = (p >> 8) & 0xFF;
+    out[3 * i + 2] = p & 0xFF;
+  }
+}
+
+// RGB565 -> packed 8-bit RGB, replicating the top bits like fb_unpack_color
+static void rgb565_to_rgb(const uint16_t *src, int n, uint8_t *out) {
+  for (int i = 0; i < n; i++, out += 3) {
+    uint32_t r = src[i] >> 11, g = (src[i] >> 5) & 0x3F, b = src[i] & 0x1F;
+    out[0] = (uint8_t)(r << 3 | r >> 2);
+    out[1] = (uint8_t)(g << 2 | g >> 4);
+    out[2] = (uint8_t)(b << 3 | b >> 2);
+  }
+}
+
+static void indexed_to_rgb(const uint8_t *src, int n, const Pixel *palette,
+                           uint8_t *out) {
+  for (int i = 0; i < n; i++, out += 3) {
+    Pixel p = palette[src[i]];
+    out[0] = (p >> 16) & 0xFF;
+    out[1] = (p >> 8) & 0xFF;
+    out[2] = p & 0xFF;
+  }
+}
 
-  FILE *f = fopen(filename, "wb");
-  if (!f) {
-    perror("fopen");
+// Unpack pixels x .. x + n - 1 of row y into 8-bit RGB, one buffer run at
+// a time
+static void convert_rgb(const Framebuffer *fb, int x, int y, int n,
+                        uint8_t *out) {
+  while (n > 0) {
+    int len = run_length(fb, x, n);
+    size_t idx = pix_index(fb, x, y);
+    switch (fb->format) {
+    case FB_FORMAT_RGB565:
+      rgb565_to_rgb((const uint16_t *)fb->pixels + idx, len, out);
+      break;
+    case FB_FORMAT_INDEXED8:
+      indexed_to_rgb((const uint8_t *)fb->pixels + idx, len, fb->palette, out);
+      break;
+    default:
+      argb_to_rgb((const Pixel *)fb->pixels + idx, len, out);
+      break;
+    }
+    x += len;
+    n -= len;
+    out += (size_t)len * 3;
+  }
+}
+
+// Store n pixels of the clear color as 8-bit RGB
+static void fill_rgb_clear(const Framebuffer *fb, int n, uint8_t *out) {
+  Pixel p = fb_unpack_color(fb, 0);
+  if (p == fb_color_rgb(0, 0, 0)) {
+    memset(out, 0, (size_t)n * 3);
     return;
   }
+  for (int i = 0; i < n; i++, out += 3) {
+    out[0] = (p >> 16) & 0xFF;
+    out[1] = (p >> 8) & 0xFF;
+    out[2] = p & 0xFF;
+  }
+}
+
+// Convert row y, x0 .. x1 - 1 into 8-bit RGB. Tiles without ink hold
+// cleared pixels and are filled without reading the framebuffer; runs of
+// tiles in the same state are handled together.
+static void row_rgb(const Framebuffer *fb, int x0, int x1, int y,
+                    uint8_t *out) {
+  int ty = y / FB_DIRTY_TILE;
+  for (int x = x0; x < x1;) {
+    int tx = x / FB_DIRTY_TILE;
+    unsigned char ink = tile_state(fb, tx, ty) & FB_DIRTY_INK;
+    while ((tx + 1) * FB_DIRTY_TILE < x1 &&
+           (tile_state(fb, tx + 1, ty) & FB_DIRTY_INK) == ink)
+      tx++;
+    int end = (tx + 1) * FB_DIRTY_TILE < x1 ? (tx + 1) * FB_DIRTY_TILE : x1;
+    uint8_t *o = out + (size_t)(x - x0) * 3;
+    if (ink)
+      convert_rgb(fb, x, y, end - x, o);
+    else
+      fill_rgb_clear(fb, end - x, o);
+    x = end;
+  }
+}
+
+void fb_read_rgb(const Framebuffer *fb, int x0, int y0, int x1, int y1,
+                 uint8_t *out) {
+  size_t stride = (size_t)(x1 - x0) * 3;
+  for (int y = y0; y < y1; y++, out += stride)
+    row_rgb(fb, x0, x1, y, out);
+}
+
+static int write_all(int fd, const uint8_t *buf, size_t size) {
+  while (size > 0) {
+    ssize_t n = write(fd, buf, size);
+    if (n < 0)
+      return -1;
+    buf += n;
+    size -= (size_t)n;
+  }
+  return 0;
+}
 
-  // PPM header
-  fprintf(f, "P6\n");
-  fprintf(f, "%d %d\n", FB_WIDTH, FB_HEIGHT);
-  fprintf(f, "255\n");
+// Write the framebuffer as a binary PPM. The file is sized up front and
+// mapped, so the pixels are converted straight into the page cache; targets
+// that cannot be mapped (pipes, devices) get one buffer and one write.
+static int write_ppm(const Framebuffer *fb, const char *filename) {
+  char header[32];
+  int hlen = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", fb->width,
+                      fb->height);
+  size_t size = (size_t)hlen + (size_t)fb->width * fb->height * 3;
 
-  // Write pixels (RGB, 8-bit each)
-  for (int i = 0; i < FB_SIZE; i++) {
-    Pixel p = fb->pixels[i];
-    uint8_t r = (p >> 16) & 0xFF;
-    uint8_t g = (p >> 8) & 0xFF;
-    uint8_t b = p & 0xFF;
+  int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return -1;
 
-    fputc(r, f);
-    fputc(g, f);
-    fputc(b, f);
+  uint8_t *map = MAP_FAILED;
+  if (ftruncate(fd, (off_t)size) == 0)
+    map = (uint8_t *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                          0);
+  if (map != MAP_FAILED) {
+    memcpy(map, header, (size_t)hlen);
+    fb_read_rgb(fb, 0, 0, fb->width, fb->height, map + hlen);
+    munmap(map, size);
+    return close(fd);
   }
 
-  fclose(f);
+  uint8_t *buf = (uint8_t *)malloc(size);
+  int rc = -1;
+  if (buf) {
+    memcpy(buf, header, (size_t)hlen);
+    fb_read_rgb(fb, 0, 0, fb->width, fb->height, buf + hlen);
+    rc = write_all(fd, buf, size);
+    free(buf);
+  }
+  if (close(fd) != 0)
+    rc = -1;
+  return rc;
+}
+
+// Dump framebuffer as PPM (Portable PixMap) file
+void fb_dump_ppm(Framebuffer *fb, const char *filename) {
+  if (!fb || !fb->pixels)
+    return;
+
+  if (write_ppm(fb, filename) != 0) {
+    perror(filename);
+    return;
+  }
   printf("Framebuffer dumped to %s\n", filename);
 }
 
@@ -173,19 +1824,24 @@ void fb_dump_ascii(Framebuffer *fb) {
 
   printf("\n=== Framebuffer (ASCII) ===\n");
 
-  for (int y = 0; y < FB_HEIGHT; y += 8) {
-    for (int x = 0; x < FB_WIDTH; x += 4) {
-      int hit = 0;
-      // Check 4x8 block
-      for (int dy = 0; dy < 8 && (y + dy) < FB_HEIGHT; dy++) {
-        for (int dx = 0; dx < 4 && (x + dx) < FB_WIDTH; dx++) {
-          if (fb->pixels[(y + dy) * FB_WIDTH + (x + dx)] != 0) {
+  // One character per 4x8 block, coarser on large framebuffers so the
+  // output stays within 64 columns
+  int bw = fb->width / 64 > 4 ? fb->width / 64 : 4;
+  int bh = bw * 2;
+
+  for (int y = 0; y < fb->height; y += bh) {
+    int y1 = y + bh < fb->height ? y + bh : fb->height;
+    for (int x = 0; x < fb->width; x += bw) {
+      int x1 = x + bw < fb->width ? x + bw : fb->width;
+      // Check the block, unless every tile under it is known black
+      int hit = 0, ink = rect_has_ink(fb, x, y, x1, y1);
+      for (int py = y; py < y1 && ink && !hit; py++) {
+        for (int px = x; px < x1; px++) {
+          if (pix_load(fb, pix_index(fb, px, py)) != 0) {
             hit = 1;
             break;
           }
         }
-        if (hit)
-          break;
       }
 
       if (hit) {
@@ -197,3 +1853,119 @@ void fb_dump_ascii(Framebuffer *fb) {
     printf("\n");
   }
 }
+
+// ========== DOUBLE BUFFERING ==========
+
+int fb_enable_front(Framebuffer *fb, FbFrameSink sink, void *ctx) {
+  if (!fb || !fb->owns_pixels || fb->front)
+    return -1;
+
+  FbFront *front = (FbFront *)calloc(1, sizeof(FbFront));
+  if (!front)
+    return -1;
+  front->rgb = (uint8_t *)malloc((size_t)fb->width * fb->height * 3);
+  if (!front->rgb) {
+    free(front);
+    return -1;
+  }
+  pthread_mutex_init(&front->lock, NULL);
+  pthread_cond_init(&front->emitted, NULL);
+  front->sink = sink;
+  front->sink_ctx = ctx;
+  front->cores = 1;
+
+  // Start from the current back buffer; later PRESENTs copy changes only
+  fb_read_rgb(fb, 0, 0, fb->width, fb->height, front->rgb);
+  fb->front = front;
+  fb->presented = 0;
+  return 0;
+}
+
+// Convert this view's changed tiles into the front buffer. Tiles the view
+// owns whole are marked unchanged; tiles shared with a neighbouring band
+// stay marked, so the other core still copies its part.
+static void front_update(Framebuffer *fb) {
+  uint8_t *rgb = fb->front->rgb;
+  int ty0 = fb->clip_y0 / FB_DIRTY_TILE;
+  int ty1 = (fb->clip_y1 - 1) / FB_DIRTY_TILE;
+  int tx0 = fb->clip_x0 / FB_DIRTY_TILE;
+  int tx1 = (fb->clip_x1 - 1) / FB_DIRTY_TILE;
+
+  for (int ty = ty0; ty <= ty1; ty++) {
+    int py0 = ty * FB_DIRTY_TILE, py1 = py0 + FB_DIRTY_TILE;
+    py1 = py1 < fb->height ? py1 : fb->height;
+    int y0 = py0 > fb->clip_y0 ? py0 : fb->clip_y0;
+    int y1 = py1 < fb->clip_y1 ? py1 : fb->clip_y1;
+    for (int tx = tx0; tx <= tx1; tx++) {
+      int px0 = tx * FB_DIRTY_TILE, px1 = px0 + FB_DIRTY_TILE;
+      px1 = px1 < fb->width ? px1 : fb->width;
+      int x0 = px0 > fb->clip_x0 ? px0 : fb->clip_x0;
+      int x1 = px1 < fb->clip_x1 ? px1 : fb->clip_x1;
+      int whole = x0 == px0 && x1 == px1 && y0 == py0 && y1 == py1;
+
+      atomic_uchar *t = &fb->dirty[(size_t)ty * fb->dirty_tiles_x + tx];
+      unsigned char state =
+          whole ? atomic_fetch_and_explicit(t, (unsigned char)~FB_DIRTY_CHANGED,
+                                            memory_order_relaxed)
+                : atomic_load_explicit(t, memory_order_relaxed);
+      if (!(state & FB_DIRTY_CHANGED))
+        continue;
+      for (int y = y0; y < y1; y++)
+        row_rgb(fb, x0, x1, y, rgb + ((size_t)y * fb->width + x0) * 3);
+    }
+  }
+}
+
+// Hand the completed frame to the sink (front->lock held)
+static void front_emit(Framebuffer *fb) {
+  FbFront *front = fb->front;
+  if (front->sink)
+    front->sink(front->sink_ctx, front->rgb, fb->width, fb->height);
+  front->frames++;
+  front->arrived = 0;
+  pthread_cond_broadcast(&front->emitted);
+}
+
+void fb_present(Framebuffer *fb) {
+  if (!fb || !fb->front)
+    return;
+  FbFront *front = fb->front;
+
+  // Wait until this view's previous frame has gone out
+  pthread_mutex_lock(&front->lock);
+  while (front->frames < fb->presented)
+    pthread_cond_wait(&front->emitted, &front->lock);
+  pthread_mutex_unlock(&front->lock);
+
+  // Views own disjoint regions of the front buffer, so no lock is needed
+  front_update(fb);
+
+  pthread_mutex_lock(&front->lock);
+  fb->presented++;
+  if (++front->arrived >= front->cores)
+    front_emit(fb);
+  pthread_mutex_unlock(&front->lock);
+}
+
+void fb_front_set_cores(Framebuffer *fb, int cores) {
+  if (!fb || !fb->front)
+    return;
+  pthread_mutex_lock(&fb->front->lock);
+  fb->front->cores = cores;
+  fb->front->arrived = 0;
+  pthread_mutex_unlock(&fb->front->lock);
+}
+
+void fb_present_leave(Framebuffer *fb) {
+  if (!fb || !fb->front)
+    return;
+  FbFront *front = fb->front;
+
+  pthread_mutex_lock(&front->lock);
+  front->cores--;
+  if (fb->presented > front->frames)
+    front->arrived--; // its band of the pending frame is already in place
+  if (front->arrived > 0 && front->arrived >= front->cores)
+    front_emit(fb);
+  pthread_mutex_unlock(&front->lock);
+}
@@ -0,0 +1,311 @@
+#include "../include/image.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static const char *const format_names[IMAGE_FORMAT_COUNT] = {
+    [IMAGE_PPM] = "ppm",
+    [IMAGE_QOI] = "qoi",
+    [IMAGE_PNG] = "png",
+};
+
+int image_format_from_name(const char *name) {
+  for (int f = 0; f < IMAGE_FORMAT_COUNT; f++) {
+    if (name && strcasecmp(name, format_names[f]) == 0)
+      return f;
+  }
+  return -1;
+}
+
+ImageFormat image_format_from_path(const char *path) {
+  const char *dot = path ? strrchr(path, '.') : NULL;
+  int format = dot ? image_format_from_name(dot + 1) : -1;
+  return format < 0 ? IMAGE_PPM : (ImageFormat)format;
+}
+
+static inline uint8_t *put_be32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)(v >> 24);
+  p[1] = (uint8_t)(v >> 16);
+  p[2] = (uint8_t)(v >> 8);
+  p[3] = (uint8_t)v;
+  return p + 4;
+}
+
+// ========== PPM ==========
+
+static uint8_t *encode_ppm(const uint8_t *rgb, int w, int h, size_t *size) {
+  char header[32];
+  int hlen = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", w, h);
+  size_t bytes = (size_t)w * h * 3;
+  uint8_t *out = (uint8_t *)malloc((size_t)hlen + bytes);
+  if (!out)
+    return NULL;
+  memcpy(out, header, (size_t)hlen);
+  memcpy(out + hlen, rgb, bytes);
+  *size = (size_t)hlen + bytes;
+  return out;
+}
+
+// ========== QOI ==========
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF 0x40
+#define QOI_OP_LUMA 0x80
+#define QOI_OP_RUN 0xC0
+#define QOI_OP_RGB 0xFE
+#define QOI_MAX_RUN 62
+
+// RGB only: alpha is always 255, so pixels are compared as r << 16 | g << 8
+// | b and the hash's alpha term is the constant 255 * 11
+static inline int qoi_hash(int r, int g, int b) {
+  return (r * 3 + g * 5 + b * 7 + 255 * 11) % 64;
+}
+
+static uint8_t *encode_qoi(const uint8_t *rgb, int w, int h, size_t *size) {
+  size_t pixels = (size_t)w * h;
+  // Worst case is a QOI_OP_RGB (4 bytes) per pixel
+  uint8_t *out = (uint8_t *)malloc(14 + pixels * 4 + 8);
+  if (!out)
+    return NULL;
+
+  uint8_t *p = out;
+  memcpy(p, "qoif", 4);
+  p = put_be32(p + 4, (uint32_t)w);
+  p = put_be32(p, (uint32_t)h);
+  *p++ = 3; // channels
+  *p++ = 0; // sRGB with linear alpha
+
+  // The index starts as transparent black, which an opaque pixel never
+  // matches
+  uint32_t index[64];
+  uint8_t index_used[64] = {0};
+  uint32_t prev = 0;
+  int run = 0;
+
+  for (size_t i = 0; i < pixels; i++, rgb += 3) {
+    int r = rgb[0], g = rgb[1], b = rgb[2];
+    uint32_t px = (uint32_t)r << 16 | (uint32_t)g << 8 | (uint32_t)b;
+
+    if (px == prev) {
+      if (++run == QOI_MAX_RUN || i + 1 == pixels) {
+        *p++ = (uint8_t)(QOI_OP_RUN | (run - 1));
+        run = 0;
+      }
+      continue;
+    }
+    if (run > 0) {
+      *p++ = (uint8_t)(QOI_OP_RUN | (run - 1));
+      run = 0;
+    }
+
+    int slot = qoi_hash(r, g, b);
+    if (index_used[slot] && index[slot] == px) {
+      *p++ = (uint8_t)(QOI_OP_INDEX | slot);
+    } else {
+      index[slot] = px;
+      index_used[slot] = 1;
+
+      int dr = (int8_t)(r - (int)(prev >> 16));
+      int dg = (int8_t)(g - (int)((prev >> 8) & 0xFF));
+      int db = (int8_t)(b - (int)(prev & 0xFF));
+      int dr_dg = dr - dg, db_dg = db - dg;
+      if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+        *p++ = (uint8_t)(QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 |
+                         (db + 2));
+      } else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 &&
+                 db_dg >= -8 && db_dg <= 7) {
+        *p++ = (uint8_t)(QOI_OP_LUMA | (dg + 32));
+        *p++ = (uint8_t)((dr_dg + 8) << 4 | (db_dg + 8));
+      } else {
+        *p++ = QOI_OP_RGB;
+        *p++ = (uint8_t)r;
+        *p++ = (uint8_t)g;
+        *p++ = (uint8_t)b;
+      }
+    }
+    prev = px;
+  }
+
+  static const uint8_t end_marker[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+  memcpy(p, end_marker, sizeof(end_marker));
+  *size = (size_t)(p - out) + sizeof(end_marker);
+  return out;
+}
+
+// ========== PNG ==========
+
+#define DEFLATE_STORED_MAX 65535
+
+static uint32_t crc_table[256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static void crc_init(void) {
+  for (uint32_t n = 0; n < 256; n++) {
+    uint32_t c = n;
+    for (int k = 0; k < 8; k++)
+      c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+    crc_table[n] = c;
+  }
+}
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *buf, size_t len) {
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++)
+    crc = crc_table[(crc ^ buf[i]) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
+static uint32_t adler32_update(uint32_t adler, const uint8_t *buf,
+                               size_t len) {
+  uint32_t a = adler & 0xFFFF, b = adler >> 16;
+  while (len > 0) {
+    // Largest block whose sums cannot overflow 32 bits before the modulo
+    size_t n = len < 5552 ? len : 5552;
+    len -= n;
+    while (n--) {
+      a += *buf++;
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+  }
+  return b << 16 | a;
+}
+
+// Write a chunk whose data is already at p + 8; returns the end of the chunk
+static uint8_t *png_chunk(uint8_t *p, const char *type, size_t len) {
+  put_be32(p, (uint32_t)len);
+  memcpy(p + 4, type, 4);
+  uint32_t crc = crc32_update(0, p + 4, len + 4);
+  return put_be32(p + 8 + len, crc);
+}
+
+static uint8_t *encode_png(const uint8_t *rgb, int w, int h, size_t *size) {
+  pthread_once(&crc_once, crc_init);
+
+  // Scanlines with filter type 0 (None) in front of each row
+  size_t stride = (size_t)w * 3;
+  size_t raw = (stride + 1) * h;
+  size_t blocks = raw / DEFLATE_STORED_MAX + 1;
+  size_t zlen = 2 + raw + 5 * blocks + 4;
+  uint8_t *out = (uint8_t *)malloc(8 + 25 + 12 + zlen + 12);
+  if (!out)
+    return NULL;
+
+  static const uint8_t signature[8] = {0x89, 'P',  'N',  'G',
+                                       '\r', '\n', 0x1A, '\n'};
+  memcpy(out, signature, sizeof(signature));
+
+  uint8_t *p = out + 8, *d = p + 8;
+  d = put_be32(d, (uint32_t)w);
+  d = put_be32(d, (uint32_t)h);
+  *d++ = 8; // bit depth
+  *d++ = 2; // truecolor
+  *d++ = 0; // deflate
+  *d++ = 0; // adaptive filtering
+  *d++ = 0; // not interlaced
+  p = png_chunk(p, "IHDR", 13);
+
+  // zlib stream of stored deflate blocks, each up to 64 KiB of scanlines
+  d = p + 8;
+  *d++ = 0x78; // deflate, 32K window
+  *d++ = 0x01; // no preset dictionary, fastest; makes the header % 31 == 0
+  uint32_t adler = 1;
+  size_t row = 0, col = 0; // next scanline byte: row, then 0 = filter byte
+  for (size_t left = raw; left > 0;) {
+    size_t n = left < DEFLATE_STORED_MAX ? left : DEFLATE_STORED_MAX;
+    left -= n;
+    *d++ = left == 0; // BFINAL, BTYPE 00 (stored)
+    *d++ = (uint8_t)n;
+    *d++ = (uint8_t)(n >> 8);
+    *d++ = (uint8_t)~n;
+    *d++ = (uint8_t)(~n >> 8);
+    uint8_t *block = d;
+    while (n > 0) {
+      if (col == 0) {
+        *d++ = 0;
+        col = 1;
+        n--;
+        continue;
+      }
+      size_t take = stride - (col - 1);
+      take = take < n ? take : n;
+      memcpy(d, rgb + row * stride + (col - 1), take);
+      d += take;
+      n -= take;
+      col += take;
+      if (col == stride + 1) {
+        row++;
+        col = 0;
+      }
+    }
+    adler = adler32_update(adler, block, (size_t)(d - block));
+  }
+  d = put_be32(d, adler);
+  p = png_chunk(p, "IDAT", (size_t)(d - (p + 8)));
+  p = png_chunk(p, "IEND", 0);
+
+  *size = (size_t)(p - out);
+  return out;
+}
+
+// ========== OUTPUT ==========
+
+uint8_t *image_encode(ImageFormat format, const uint8_t *rgb, int width,
+                      int height, size_t *size) {
+  if (!rgb || !size || width < 1 || height < 1)
+    return NULL;
+
+  switch (format) {
+  case IMAGE_QOI:
+    return encode_qoi(rgb, width, height, size);
+  case IMAGE_PNG:
+    return encode_png(rgb, width, height, size);
+  default:
+    return encode_ppm(rgb, width, height, size);
+  }
+}
+
+int image_write(const char *path, ImageFormat format, const uint8_t *rgb,
+                int width, int height) {
+  size_t size;
+  uint8_t *data = image_encode(format, rgb, width, height, &size);
+  if (!data)
+    return -1;
+
+  FILE *f = fopen(path, "wb");
+  int rc = -1;
+  if (f) {
+    rc = fwrite(data, 1, size, f) == size ? 0 : -1;
+    if (fclose(f) != 0)
+      rc = -1;
+  }
+  free(data);
+  return rc;
+}
+
+int image_dump_fb(Framebuffer *fb, const char *path, ImageFormat format) {
+  if (!fb || !fb->pixels)
+    return -1;
+
+  // PPM is converted straight into the mapped output file
+  if (format == IMAGE_PPM) {
+    fb_dump_ppm(fb, path);
+    return 0;
+  }
+
+  uint8_t *rgb = (uint8_t *)malloc((size_t)fb->width * fb->height * 3);
+  if (!rgb)
+    return -1;
+  fb_read_rgb(fb, 0, 0, fb->width, fb->height, rgb);
+  int rc = image_write(path, format, rgb, fb->width, fb->height);
+  free(rgb);
+  if (rc != 0) {
+    perror(path);
+    return -1;
+  }
+  printf("Framebuffer dumped to %s\n", path);
+  return 0;
+}
@@ -1,43 +1,378 @@
+#include "../include/config.h"
+#include "../include/data_memory.h"
 #include "../include/execution.h"
+#include "../include/gfx_unit.h"
 #include "../include/graphics.h"
+#include "../include/image.h"
 #include "../include/isa.h"
+#include "../include/mmio.h"
 #include "../include/parse_instruction.h"
+#include "../include/trig.h"
+#include "../include/vector.h"
+#include "../include/video.h"
+#include <getopt.h>
+#include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
-int32_t regs[32];
-extern Framebuffer *global_fb;
+__thread int32_t regs[32];
+extern __thread Framebuffer *global_fb;
+
+SimConfig sim_config = {
+    .gfx_queue_depth = GFX_QUEUE_DEFAULT_DEPTH,
+    .raster_ppc = 4,
+    .raster_setup = 2,
+    .num_cores = 1,
+    .vector_lanes = VLEN_MAX,
+    .depth_bits = 16,
+    .fb_width = FB_WIDTH,
+    .fb_height = FB_HEIGHT,
+    .fb_format = FB_FORMAT_ARGB8888,
+    .fb_layout = FB_LAYOUT_LINEAR,
+    .data_mem_mb = DMEM_DEFAULT_MB,
+    .mmio_base = MMIO_DEFAULT_BASE,
+    .mul_latency = 1,
+};
+
+// Long-only options
+enum {
+  OPT_RASTER_PPC = 256,
+  OPT_RASTER_SETUP,
+  OPT_MUL_LATENCY,
+  OPT_VLEN,
+  OPT_DEPTH_BITS,
+  OPT_RESOLUTION,
+  OPT_FORMAT,
+  OPT_LAYOUT,
+  OPT_PALETTE,
+  OPT_STREAM,
+  OPT_STREAM_FORMAT,
+  OPT_FPS,
+  OPT_MEM_SIZE,
+  OPT_MMIO_BASE,
+  OPT_DATA
+};
+
+#define MAX_DATA_FILES 16
 
 void print_usage(const char *prog) {
   printf("Usage: %s [options] <program.instr>\n", prog);
   printf("\nOptions:\n");
   printf("  -p, --pipelined     Run pipelined (5-stage) model\n");
   printf("  -s, --single        Run single-cycle model\n");
-  printf(
-      "  -o, --output FILE   Output PPM filename (default: framebuffer.ppm)\n");
-  printf("\nDefault: pipelined model\n");
+  printf("  -o, --output FILE   Output image; .qoi and .png select QOI or PNG,\n"
+         "                      anything else PPM (default: framebuffer.ppm)\n");
+  printf("  -q, --gfx-queue N   Graphics command queue depth (default: %d,\n"
+         "                      0 = draw inline in the IO stage)\n",
+         GFX_QUEUE_DEFAULT_DEPTH);
+  printf("      --raster-ppc N  Raster fill rate in pixels per cycle "
+         "(default: %d)\n",
+         sim_config.raster_ppc);
+  printf("      --raster-setup N  Setup cycles per drawing primitive "
+         "(default: %d)\n",
+         sim_config.raster_setup);
+  printf("      --mul-latency N  EX cycles of MUL and MAC; DOT takes one more\n"
+         "                      (default: %d)\n",
+         sim_config.mul_latency);
+  printf("  -c, --cores N       Run N pipelined cores on separate threads, each\n"
+         "                      owning one horizontal band of the screen\n");
+  printf("      --vlen N        Vector lanes: 4 or 8 (default: %d)\n", VLEN_MAX);
+  printf("      --depth-bits N  Depth buffer: 16, 32 or 0 for none (default: 16)\n");
+  printf("      --resolution WxH  Framebuffer size, up to %dx%d (default: "
+         "%dx%d)\n",
+         FB_MAX_WIDTH, FB_MAX_HEIGHT, FB_WIDTH, FB_HEIGHT);
+  printf("      --format F      Pixel format: argb8888, rgb565 or indexed8\n"
+         "                      (default: argb8888)\n");
+  printf("      --palette FILE  Palette for indexed8: up to 256 little-endian\n"
+         "                      0x00RRGGBB words (default: 3-3-2 RGB)\n");
+  printf("      --layout L      Pixel memory layout: linear or tiled (8x8)\n"
+         "                      (default: linear)\n");
+  printf("      --mem-size MB   Data address space, up to %d MB; pages are\n"
+         "                      allocated on first store (default: %d)\n",
+         DMEM_MAX_MB, DMEM_DEFAULT_MB);
+  printf("      --data FILE[@A] Map a binary file into data memory at word\n"
+         "                      address A (default: 0); repeatable\n");
+  printf("      --mmio-base A   Word address of the memory-mapped framebuffer\n"
+         "                      and registers, past data memory (default: "
+         "0x%x)\n",
+         MMIO_DEFAULT_BASE);
+  printf("      --stream FILE   Write each PRESENTed frame to FILE ('-' = "
+         "stdout;\n"
+         "                      other output then goes to stderr)\n");
+  printf("      --stream-format F  y4m (YUV 4:2:0) or rgb (raw rgb24) "
+         "(default: y4m),\n"
+         "                      or ppm, qoi or png for one file per frame "
+         "named\n"
+         "                      by FILE (e.g. frame%%04d.qoi)\n");
+  printf("      --fps N         Frame rate recorded in Y4M streams "
+         "(default: 30)\n");
+  printf("  -h, --help          Show this message\n");
+  printf("\nDefault: run both models\n");
+}
+
+// Open the video stream target. For "-" the stream keeps the real stdout
+// and everything the simulator prints is sent to stderr instead.
+static FILE *open_stream(const char *path) {
+  if (strcmp(path, "-") != 0)
+    return fopen(path, "wb");
+
+  fflush(stdout);
+  int fd = dup(STDOUT_FILENO);
+  if (fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0)
+    return NULL;
+  return fdopen(fd, "wb");
+}
+
+// Replace the indexed8 palette with the 0x00RRGGBB words of a binary file
+static int load_palette(Framebuffer *fb, const char *path) {
+  if (fb->format != FB_FORMAT_INDEXED8) {
+    fprintf(stderr, "--palette needs --format indexed8\n");
+    return -1;
+  }
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return -1;
+  }
+  uint8_t bytes[256 * 4];
+  size_t n = fread(bytes, 1, sizeof(bytes), f) / 4;
+  fclose(f);
+  if (n == 0) {
+    fprintf(stderr, "Palette '%s' holds no colors\n", path);
+    return -1;
+  }
+
+  Pixel colors[256];
+  for (size_t i = 0; i < n; i++)
+    colors[i] = fb_color_rgb(bytes[4 * i + 2], bytes[4 * i + 1], bytes[4 * i]);
+  return fb_set_palette(fb, colors, (int)n);
 }
 
 int main(int argc, char **argv) {
   int mode = -1;
   const char *filename = "program.instr";
   const char *output_file = "framebuffer.ppm";
+  const char *stream_file = NULL;
+  const char *palette_file = NULL;
+  const char *data_files[MAX_DATA_FILES];
+  int data_file_count = 0;
+  int stream_format = VIDEO_Y4M;
+  int fps = 30;
+
+  static const struct option long_opts[] = {
+      {"pipelined", no_argument, NULL, 'p'},
+      {"single", no_argument, NULL, 's'},
+      {"output", required_argument, NULL, 'o'},
+      {"gfx-queue", required_argument, NULL, 'q'},
+      {"raster-ppc", required_argument, NULL, OPT_RASTER_PPC},
+      {"raster-setup", required_argument, NULL, OPT_RASTER_SETUP},
+      {"mul-latency", required_argument, NULL, OPT_MUL_LATENCY},
+      {"cores", required_argument, NULL, 'c'},
+      {"vlen", required_argument, NULL, OPT_VLEN},
+      {"depth-bits", required_argument, NULL, OPT_DEPTH_BITS},
+      {"resolution", required_argument, NULL, OPT_RESOLUTION},
+      {"format", required_argument, NULL, OPT_FORMAT},
+      {"layout", required_argument, NULL, OPT_LAYOUT},
+      {"palette", required_argument, NULL, OPT_PALETTE},
+      {"stream", required_argument, NULL, OPT_STREAM},
+      {"stream-format", required_argument, NULL, OPT_STREAM_FORMAT},
+      {"fps", required_argument, NULL, OPT_FPS},
+      {"mem-size", required_argument, NULL, OPT_MEM_SIZE},
+      {"mmio-base", required_argument, NULL, OPT_MMIO_BASE},
+      {"data", required_argument, NULL, OPT_DATA},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0}};
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "pso:q:c:h", long_opts, NULL)) != -1) {
+    switch (opt) {
+    case 'p':
+      mode = EXEC_MODE_PIPELINED;
+      break;
+    case 's':
+      mode = EXEC_MODE_SINGLE_CYCLE;
+      break;
+    case 'o':
+      output_file = optarg;
+      break;
+    case 'q':
+      sim_config.gfx_queue_depth = atoi(optarg);
+      if (sim_config.gfx_queue_depth < 0)
+        sim_config.gfx_queue_depth = 0;
+      break;
+    case 'c':
+      sim_config.num_cores = atoi(optarg);
+      if (sim_config.num_cores < 1)
+        sim_config.num_cores = 1;
+      break;
+    case OPT_VLEN:
+      sim_config.vector_lanes = (atoi(optarg) <= 4) ? 4 : VLEN_MAX;
+      break;
+    case OPT_DEPTH_BITS:
+      sim_config.depth_bits = atoi(optarg);
+      if (sim_config.depth_bits != 16 && sim_config.depth_bits != 32)
+        sim_config.depth_bits = 0;
+      break;
+    case OPT_RESOLUTION: {
+      int w = 0, h = 0;
+      if (sscanf(optarg, "%dx%d", &w, &h) != 2 || w < 1 || h < 1 ||
+          w > FB_MAX_WIDTH || h > FB_MAX_HEIGHT) {
+        fprintf(stderr, "Invalid resolution '%s' (max %dx%d)\n", optarg,
+                FB_MAX_WIDTH, FB_MAX_HEIGHT);
+        return 1;
+      }
+      sim_config.fb_width = w;
+      sim_config.fb_height = h;
+      break;
+    }
+    case OPT_FORMAT:
+      sim_config.fb_format = fb_format_from_name(optarg);
+      if (sim_config.fb_format < 0) {
+        fprintf(stderr, "Unknown pixel format '%s'\n", optarg);
+        return 1;
+      }
+      break;
+    case OPT_PALETTE:
+      palette_file = optarg;
+      break;
+    case OPT_LAYOUT:
+      sim_config.fb_layout = fb_layout_from_name(optarg);
+      if (sim_config.fb_layout < 0) {
+        fprintf(stderr, "Unknown framebuffer layout '%s'\n", optarg);
+        return 1;
+      }
+      break;
+    case OPT_STREAM:
+      stream_file = optarg;
+      break;
+    case OPT_STREAM_FORMAT:
+      stream_format = video_format_from_name(optarg);
+      if (stream_format < 0) {
+        fprintf(stderr, "Unknown stream format '%s'\n", optarg);
+        return 1;
+      }
+      break;
+    case OPT_FPS:
+      fps = atoi(optarg);
+      if (fps < 1)
+        fps = 1;
+      break;
+    case OPT_MEM_SIZE:
+      sim_config.data_mem_mb = atoi(optarg);
+      if (sim_config.data_mem_mb < 1 || sim_config.data_mem_mb > DMEM_MAX_MB) {
+        fprintf(stderr, "Invalid data memory size '%s' (1-%d MB)\n", optarg,
+                DMEM_MAX_MB);
+        return 1;
+      }
+      break;
+    case OPT_DATA:
+      if (data_file_count == MAX_DATA_FILES) {
+        fprintf(stderr, "At most %d --data files\n", MAX_DATA_FILES);
+        return 1;
+      }
+      data_files[data_file_count++] = optarg;
+      break;
+    case OPT_MMIO_BASE: {
+      char *end;
+      unsigned long base = strtoul(optarg, &end, 0);
+      if (*end || base > UINT32_MAX - MMIO_WINDOW_WORDS) {
+        fprintf(stderr, "Invalid MMIO base '%s'\n", optarg);
+        return 1;
+      }
+      sim_config.mmio_base = (uint32_t)base;
+      break;
+    }
+    case OPT_RASTER_PPC:
+      sim_config.raster_ppc = atoi(optarg);
+      if (sim_config.raster_ppc < 1)
+        sim_config.raster_ppc = 1;
+      break;
+    case OPT_RASTER_SETUP:
+      sim_config.raster_setup = atoi(optarg);
+      if (sim_config.raster_setup < 0)
+        sim_config.raster_setup = 0;
+      break;
+    case OPT_MUL_LATENCY:
+      sim_config.mul_latency = atoi(optarg);
+      if (sim_config.mul_latency < 1)
+        sim_config.mul_latency = 1;
+      break;
+    case 'h':
+      print_usage(argv[0]);
+      return 0;
+    default:
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (optind < argc) {
+    filename = argv[optind];
+  }
+
+  // Each core owns at least one framebuffer row
+  if (sim_config.num_cores > sim_config.fb_height)
+    sim_config.num_cores = sim_config.fb_height;
 
-  if (argc > 1) {
-    filename = argv[1];
+  FILE *stream_out = NULL;
+  if (stream_file && video_is_sequence((VideoFormat)stream_format)) {
+    if (strcmp(stream_file, "-") == 0) {
+      fprintf(stderr, "Image sequences cannot go to stdout\n");
+      return 1;
+    }
+  } else if (stream_file) {
+    stream_out = open_stream(stream_file);
+    if (!stream_out) {
+      perror(stream_file);
+      return 1;
+    }
+    signal(SIGPIPE, SIG_IGN); // a closed pipe ends the stream, not the run
   }
 
   LabelEntry labels[256];
   int label_count = 0;
 
+  trig_init();
+
   // === Initialize Graphics ===
-  global_fb = fb_init();
+  global_fb = fb_create(sim_config.fb_width, sim_config.fb_height,
+                        (PixelFormat)sim_config.fb_format,
+                        (FbLayout)sim_config.fb_layout);
   if (!global_fb) {
     fprintf(stderr, "Failed to initialize framebuffer\n");
     return 1;
   }
-  printf("Framebuffer initialized: %dx%d\n", FB_WIDTH, FB_HEIGHT);
+  if (sim_config.depth_bits &&
+      fb_enable_depth(global_fb, sim_config.depth_bits) != 0) {
+    fprintf(stderr, "Failed to allocate depth buffer\n");
+    fb_free(global_fb);
+    return 1;
+  }
+  if (palette_file && load_palette(global_fb, palette_file) != 0) {
+    fb_free(global_fb);
+    return 1;
+  }
+  printf("Framebuffer initialized: %dx%d (%s, %s)\n", global_fb->width,
+         global_fb->height, fb_format_name(global_fb->format),
+         fb_layout_name(global_fb->layout));
+
+  VideoStream *video = NULL;
+  if (stream_file) {
+    if (stream_out)
+      video = video_open(stream_out, (VideoFormat)stream_format,
+                         global_fb->width, global_fb->height, fps);
+    else
+      video = video_open_sequence(stream_file, (VideoFormat)stream_format,
+                                  global_fb->width, global_fb->height);
+    if (!video) {
+      fprintf(stderr, "Failed to start video stream\n");
+      fb_free(global_fb);
+      return 1;
+    }
+  }
 
   // === PASS 1: Collect labels ===
   detectLabels(filename, labels, &label_count);
@@ -48,25 +383,65 @@ int main(int argc, char **argv) {
     fb_free(global_fb);
     return 1;
   }
-  printf("Loaded %zu instructions.\n\n", im.size);
+  // Binary data files, mapped in at the start of each run
+  for (int i = 0; i < data_file_count; i++) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s", data_files[i]);
+    uint32_t addr = 0;
+    char *at = strrchr(path, '@');
+    if (at) {
+      char *end;
+      *at = '\0';
+      addr = (uint32_t)strtoul(at + 1, &end, 0);
+      if (at[1] == '\0' || *end) {
+        fprintf(stderr, "Invalid data address in '%s'\n", data_files[i]);
+        free_imem(&im);
+        fb_free(global_fb);
+        return 1;
+      }
+    }
+    if (dmem_image_file(&im.data, path, addr) != 0) {
+      perror(path);
+      free_imem(&im);
+      fb_free(global_fb);
+      return 1;
+    }
+  }
+
+  printf("Loaded %zu instructions.\n", im.size);
+  if (im.data.count > 0) {
+    uint64_t words = 0;
+    for (int i = 0; i < im.data.count; i++)
+      words += im.data.segs[i].words;
+    printf("Data image: %lu words in %d segments\n", (unsigned long)words,
+           im.data.count);
+  }
+  printf("\n");
 
   // === Execute program ===
   ExecutionResult *exec_result = NULL;
 
-  // Default: Run BOTH
-  printf("\n===========================================\n");
-  printf(">>> Running SINGLE-CYCLE Mode <<<\n");
-  printf("===========================================\n");
-  ExecutionResult *res1 =
-      execute_program(EXEC_MODE_SINGLE_CYCLE, &im, labels, label_count,
-                      global_fb, "trace_single.txt");
-  execution_free(res1);
-
-  printf("\n===========================================\n");
-  printf(">>> Running PIPELINED Mode <<<\n");
-  printf("===========================================\n");
-  exec_result = execute_program(EXEC_MODE_PIPELINED, &im, labels, label_count,
-                                global_fb, "trace_pipe.txt");
+  // Default: Run BOTH. Frames are streamed from the last run only.
+  if (mode != EXEC_MODE_PIPELINED) {
+    if (video && mode == EXEC_MODE_SINGLE_CYCLE)
+      fb_enable_front(global_fb, video_frame, video);
+    printf("\n===========================================\n");
+    printf(">>> Running SINGLE-CYCLE Mode <<<\n");
+    printf("===========================================\n");
+    exec_result = execute_program(EXEC_MODE_SINGLE_CYCLE, &im, labels,
+                                  label_count, global_fb, "trace_single.txt");
+  }
+
+  if (mode != EXEC_MODE_SINGLE_CYCLE) {
+    execution_free(exec_result);
+    if (video)
+      fb_enable_front(global_fb, video_frame, video);
+    printf("\n===========================================\n");
+    printf(">>> Running PIPELINED Mode <<<\n");
+    printf("===========================================\n");
+    exec_result = execute_program(EXEC_MODE_PIPELINED, &im, labels,
+                                  label_count, global_fb, "trace_pipe.txt");
+  }
 
   // If exec_result is NULL (should not happen), handle it.
   if (!exec_result)
@@ -82,8 +457,21 @@ int main(int argc, char **argv) {
 
   // === Graphics Output ===
   printf("\n=== Graphics Output ===\n");
-  fb_dump_ppm(global_fb, output_file);
+  int dx0, dy0, dx1, dy1;
+  int dirty = fb_dirty_bounds(global_fb, &dx0, &dy0, &dx1, &dy1);
+  if (dirty)
+    printf("Changed tiles: %d of %d, bounding box (%d, %d)-(%d, %d)\n", dirty,
+           global_fb->dirty_tiles_x * global_fb->dirty_tiles_y, dx0, dy0, dx1,
+           dy1);
+  image_dump_fb(global_fb, output_file, image_format_from_path(output_file));
   fb_dump_ascii(global_fb);
+  if (video) {
+    printf("Streamed %lu frames to %s\n", (unsigned long)video->frames,
+           stream_file);
+    video_close(video);
+    if (stream_out)
+      fclose(stream_out);
+  }
 
   // Cleanup
   execution_free(exec_result);
@@ -1,9 +1,16 @@
 #include <ctype.h>
+#include <stdarg.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "../include/executor.h"
 #include "../include/isa.h"
+#include "../include/parse_instruction.h"
 
 // Helper: trim whitespace in-place
 static void trim(char *s) {
@@ -41,6 +48,465 @@ int lookup_label(const char *name, LabelEntry table[], int count) {
   return -1; // not found
 }
 
+static const LabelEntry *find_label(const char *name, LabelEntry table[],
+                                    int count) {
+  for (int i = 0; i < count; i++) {
+    if (strcmp(table[i].name, name) == 0)
+      return &table[i];
+  }
+  return NULL;
+}
+
+// ========== DATA DIRECTIVES ==========
+
+// Directive errors are reported by pass 2 (img != NULL) only
+static void asm_error(const DmemImage *img, const char *fmt, ...) {
+  if (!img)
+    return;
+  va_list ap;
+  va_start(ap, fmt);
+  printf("ERROR: ");
+  vprintf(fmt, ap);
+  printf("\n");
+  va_end(ap);
+}
+
+// .incbin operand: path relative to the source file, quotes optional
+static void incbin_path(const char *arg, const char *source, char *out,
+                        size_t size) {
+  char name[256];
+  snprintf(name, sizeof(name), "%s", arg);
+  size_t len = strlen(name);
+  char *p = name;
+  if (len >= 2 && name[0] == '"' && name[len - 1] == '"') {
+    name[len - 1] = '\0';
+    p++;
+  }
+
+  const char *slash = strrchr(source, '/');
+  if (p[0] == '/' || !slash)
+    snprintf(out, size, "%s", p);
+  else
+    snprintf(out, size, "%.*s/%s", (int)(slash - source), source, p);
+}
+
+static int incbin(const char *arg, AsmState *st, DmemImage *img) {
+  char path[512];
+  incbin_path(arg, st->path, path, sizeof(path));
+
+  int fd = open(path, O_RDONLY);
+  struct stat sb;
+  if (fd < 0 || fstat(fd, &sb) != 0) {
+    asm_error(img, ".incbin cannot read '%s'", path);
+    if (fd >= 0)
+      close(fd);
+    return -1;
+  }
+
+  size_t bytes = (size_t)sb.st_size;
+  int rc = 0;
+  if (img && bytes > 0) {
+    void *src = mmap(NULL, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (src == MAP_FAILED || dmem_image_put(img, st->loc, src, bytes) != 0) {
+      asm_error(img, ".incbin cannot load '%s'", path);
+      rc = -1;
+    }
+    if (src != MAP_FAILED)
+      munmap(src, bytes);
+  }
+  close(fd);
+
+  st->loc += (uint32_t)((bytes + 3) / 4);
+  return rc;
+}
+
+int asm_directive(const char *line, AsmState *st, DmemImage *img,
+                  LabelEntry labels[], int label_count) {
+  if (line[0] != '.')
+    return 0;
+
+  char buf[256];
+  snprintf(buf, sizeof(buf), "%s", line);
+  char *hash = strchr(buf, '#');
+  if (hash)
+    *hash = '\0';
+
+  char *save = NULL;
+  char *dir = strtok_r(buf, " \t", &save);
+  char *args = strtok_r(NULL, "", &save);
+
+  if (strcasecmp(dir, ".text") == 0) {
+    st->in_data = 0;
+    return 1;
+  }
+
+  if (strcasecmp(dir, ".data") == 0) {
+    st->in_data = 1;
+    char *addr = args ? strtok_r(args, " \t", &save) : NULL;
+    if (addr) {
+      if (!is_numeric(addr)) {
+        asm_error(img, ".data address '%s' is not a number", addr);
+        return -1;
+      }
+      st->loc = (uint32_t)strtoul(addr, NULL, 0);
+    }
+    return 1;
+  }
+
+  if (strcasecmp(dir, ".word") != 0 && strcasecmp(dir, ".incbin") != 0) {
+    asm_error(img, "Unknown directive '%s'", dir);
+    return -1;
+  }
+  if (!st->in_data) {
+    asm_error(img, "%s outside a .data section", dir);
+    return -1;
+  }
+  if (!args) {
+    asm_error(img, "%s needs an operand", dir);
+    return -1;
+  }
+
+  if (strcasecmp(dir, ".incbin") == 0) {
+    trim(args);
+    return incbin(args, st, img) == 0 ? 1 : -1;
+  }
+
+  for (char *v = strtok_r(args, " ,\t", &save); v;
+       v = strtok_r(NULL, " ,\t", &save)) {
+    if (img) {
+      // Pass 2: labels are known now
+      int32_t word;
+      const LabelEntry *label = find_label(v, labels, label_count);
+      if (is_numeric(v)) {
+        word = (int32_t)strtoll(v, NULL, 0);
+      } else if (label) {
+        word = label->address;
+      } else {
+        asm_error(img, "Undefined label '%s'", v);
+        return -1;
+      }
+      if (dmem_image_put(img, st->loc, &word, sizeof(word)) != 0)
+        return -1;
+    }
+    st->loc++;
+  }
+  return 1;
+}
+
+// ========== PSEUDO-INSTRUCTIONS ==========
+
+// Instructions materializing v: ADDI when v fits the 15-bit immediate,
+// LUI alone when its low 12 bits are clear, else LUI + ORI
+static int li_expand(const char *rd, uint32_t v, char out[][64]) {
+  int32_t s = (int32_t)v;
+  uint32_t lo = v & ((1u << LUI_SHIFT) - 1);
+  if (s >= -(1 << (IMM_I_BITS - 1)) && s < (1 << (IMM_I_BITS - 1))) {
+    if (out)
+      snprintf(out[0], 64, "ADDI %s, x0, %d", rd, s);
+    return 1;
+  }
+  if (out)
+    snprintf(out[0], 64, "LUI %s, 0x%x", rd, v >> LUI_SHIFT);
+  if (lo == 0)
+    return 1;
+  if (out)
+    snprintf(out[1], 64, "ORI %s, %s, 0x%x", rd, rd, lo);
+  return 2;
+}
+
+// MUL/DIV by a power of two turned into shifts by the current build_imem()
+static int strength_reduced;
+
+// log2(c) if c is a positive power of two, else -1
+static int pow2_log(int32_t c) {
+  if (c <= 0 || (c & (c - 1)))
+    return -1;
+  return __builtin_ctz((uint32_t)c);
+}
+
+// MUL/DIV rd, rs, c. A power of two becomes shifts; DIV rounds toward zero
+// like the divider by biasing negative dividends by c - 1 first, using rd
+// as scratch. Other constants are loaded into rd. Both need rd != rs.
+static int muldiv_expand(int div, const char *rd, const char *rs, int32_t c,
+                         char out[][64], const char *line) {
+  int k = pow2_log(c);
+  if (k == 0 || (k > 0 && !div)) {
+    if (out) {
+      snprintf(out[0], 64, "SLLI %s, %s, %d", rd, rs, k);
+      strength_reduced++;
+    }
+    return 1;
+  }
+
+  int distinct = parse_register(rd) != parse_register(rs);
+  if (k > 0 && distinct) {
+    if (out) {
+      snprintf(out[0], 64, "SRAI %s, %s, 31", rd, rs);
+      snprintf(out[1], 64, "SRLI %s, %s, %d", rd, rd, 32 - k);
+      snprintf(out[2], 64, "ADD %s, %s, %s", rd, rd, rs);
+      snprintf(out[3], 64, "SRAI %s, %s, %d", rd, rd, k);
+      strength_reduced++;
+    }
+    return 4;
+  }
+
+  if (!distinct) {
+    if (out)
+      printf("ERROR: %s by this constant needs rd different from rs1: %s\n",
+             div ? "DIV" : "MUL", line);
+    return -1;
+  }
+  int n = li_expand(rd, (uint32_t)c, out);
+  if (out)
+    snprintf(out[n], 64, "%s %s, %s, %s", div ? "DIV" : "MUL", rd, rs, rd);
+  return n + 1;
+}
+
+int asm_pseudo(const char *line, char out[][64], LabelEntry labels[],
+               int label_count) {
+  char buf[256];
+  snprintf(buf, sizeof(buf), "%s", line);
+  char *hash = strchr(buf, '#');
+  if (hash)
+    *hash = '\0';
+
+  char *save = NULL;
+  char *op = strtok_r(buf, " ,\t", &save);
+  if (op && (strcasecmp(op, "MUL") == 0 || strcasecmp(op, "DIV") == 0)) {
+    char *rd = strtok_r(NULL, " ,\t", &save);
+    char *rs = strtok_r(NULL, " ,\t", &save);
+    char *c = strtok_r(NULL, " ,\t", &save);
+    if (!rd || !rs || !c || !is_numeric(c))
+      return 0; // register form
+    return muldiv_expand(toupper((unsigned char)op[0]) == 'D', rd, rs,
+                         (int32_t)strtoll(c, NULL, 0), out, line);
+  }
+  if (!op || strcasecmp(op, "LI") != 0)
+    return 0;
+
+  char *rd = strtok_r(NULL, " ,\t", &save);
+  char *value = strtok_r(NULL, " ,\t", &save);
+  if (!rd || !value) {
+    if (out)
+      printf("ERROR: LI needs a register and a value: %s\n", line);
+    return -1;
+  }
+
+  if (is_numeric(value))
+    return li_expand(rd, (uint32_t)strtoll(value, NULL, 0), out);
+
+  // A label's value is only known in pass 2: always take the pair
+  if (out) {
+    const LabelEntry *label = find_label(value, labels, label_count);
+    if (!label) {
+      printf("ERROR: Undefined label '%s'\n", value);
+      return -1;
+    }
+    uint32_t v = (uint32_t)label->address;
+    snprintf(out[0], 64, "LUI %s, 0x%x", rd, v >> LUI_SHIFT);
+    snprintf(out[1], 64, "ORI %s, %s, 0x%x", rd, rd,
+             v & ((1u << LUI_SHIFT) - 1));
+  }
+  return 2;
+}
+
+// ========== STRENGTH REDUCTION ==========
+
+// Ops evaluated at assembly time when their sources are known
+static int is_foldable(Opcode op) {
+  switch (op) {
+  case OP_ADD:
+  case OP_ADDI:
+  case OP_SUB:
+  case OP_SUBI:
+  case OP_MUL:
+  case OP_LUI:
+  case OP_AND:
+  case OP_OR:
+  case OP_XOR:
+  case OP_SLL:
+  case OP_SRL:
+  case OP_SRA:
+  case OP_ANDI:
+  case OP_ORI:
+  case OP_XORI:
+  case OP_SLLI:
+  case OP_SRLI:
+  case OP_SRAI:
+  case OP_SLT:
+  case OP_SEQ:
+  case OP_MIN:
+  case OP_MAX:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+// Value of register r if known at this point of the block
+static int known_value(uint32_t known, const int32_t *value, int r,
+                       int32_t *v) {
+  if (r == 0) {
+    *v = 0;
+    return 1;
+  }
+  if (r < 0 || r > 31 || !(known >> r & 1))
+    return 0;
+  *v = value[r];
+  return 1;
+}
+
+// Rewrite MUL rd, rs1, rs2 as SLLI where one source holds a power of two
+// on every path to it. Registers are tracked through constant ALU ops
+// within basic blocks: knowledge is dropped at every branch target.
+// Rewrites are one for one, so no PC or branch offset moves.
+static void strength_reduce(InstMem *im) {
+  uint8_t *leader = calloc(im->size ? im->size : 1, 1);
+  if (!leader)
+    return;
+  for (size_t i = 0; i < im->size; i++) {
+    DecodedInst d;
+    instruction_parser(im->lines[i], (uint32_t)i, &d);
+    int64_t target = (int64_t)i + d.imm;
+    if (d.valid && (d.op == OP_BEQ || d.op == OP_BLT) && target >= 0 &&
+        target < (int64_t)im->size)
+      leader[target] = 1;
+  }
+
+  uint32_t known = 0;
+  int32_t value[32];
+  for (size_t i = 0; i < im->size; i++) {
+    if (leader[i])
+      known = 0;
+
+    DecodedInst d;
+    instruction_parser(im->lines[i], (uint32_t)i, &d);
+    if (!d.valid)
+      continue;
+
+    int32_t a = 0, b = 0;
+    if (d.op == OP_MUL) {
+      int ka = known_value(known, value, d.rs1, &a) ? pow2_log(a) : -1;
+      int kb = known_value(known, value, d.rs2, &b) ? pow2_log(b) : -1;
+      if (ka >= 0 || kb >= 0) {
+        char line[64];
+        snprintf(line, sizeof(line), "SLLI x%d, x%d, %d", d.rd,
+                 kb >= 0 ? d.rs1 : d.rs2, kb >= 0 ? kb : ka);
+        free(im->lines[i]);
+        im->lines[i] = strdup(line);
+        instruction_parser(im->lines[i], (uint32_t)i, &d);
+        strength_reduced++;
+      }
+    }
+
+    // Anything else naming rd (even as a source or vector register) ends
+    // what is known about it, and about the rest of an XFORM's vec4
+    if (!(op_operands(d.op) & USES_RD) || d.rd < 0 || d.rd > 31)
+      continue;
+
+    unsigned uses = op_operands(d.op);
+    int sources = (!(uses & USES_RS1) || known_value(known, value, d.rs1, &a)) &&
+                  (!(uses & USES_RS2) || known_value(known, value, d.rs2, &b));
+    if (is_foldable(d.op) && sources) {
+      int32_t scratch[32];
+      ExecResult r = execute_inst(d.op, d.rd, d.rs1, d.rs2, d.imm, (uint32_t)i,
+                                  (uses & USES_RS1) ? a : 0,
+                                  (uses & USES_RS2) ? b : 0, 0, scratch, NULL,
+                                  NULL);
+      value[d.rd] = r.alu_result;
+      known |= 1u << d.rd;
+    } else {
+      for (int k = 0; k < rd_span(d.op) && d.rd + k < 32; k++)
+        known &= ~(1u << (d.rd + k));
+    }
+  }
+  free(leader);
+}
+
+// ========== ENCODING ==========
+
+// Whether a decoded word carries everything the parser produced
+static int round_trips(const DecodedInst *parsed, const DecodedInst *back) {
+  unsigned uses = op_operands(parsed->op);
+  if (back->op != parsed->op)
+    return 0;
+  if ((uses & USES_RD) ? back->rd != parsed->rd : parsed->rd > 0)
+    return 0;
+  if ((uses & USES_RS1) ? back->rs1 != parsed->rs1 : parsed->rs1 > 0)
+    return 0;
+  if ((uses & USES_RS2) ? back->rs2 != parsed->rs2 : parsed->rs2 > 0)
+    return 0;
+  return (uses & USES_IMM) ? back->imm == parsed->imm : parsed->imm == 0;
+}
+
+// Encode every line into im->code. Lines that do not parse become
+// OP_INVALID words, which execute as bubbles just like before.
+static int encode_imem(InstMem *im) {
+  im->code = calloc(im->size ? im->size : 1, sizeof(uint32_t));
+  if (!im->code)
+    return -1;
+
+  for (size_t i = 0; i < im->size; i++) {
+    DecodedInst parsed, back;
+    instruction_parser(im->lines[i], (uint32_t)i, &parsed);
+    if (!parsed.valid) {
+      im->code[i] = encode_instruction(OP_INVALID, -1, -1, -1, 0);
+      continue;
+    }
+
+    im->code[i] = encode_instruction(parsed.op, parsed.rd, parsed.rs1,
+                                     parsed.rs2, parsed.imm);
+    decode_instruction(im->code[i], (uint32_t)i, &back);
+    if (!round_trips(&parsed, &back)) {
+      printf("ERROR: Operand out of range for %s encoding: %s\n",
+             op_name(parsed.op), im->lines[i]);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// Replace operands naming a .data label, alone or as the offset of
+// "LABEL(xN)", with the label's word address
+static void resolve_data_labels(char *line, size_t size, LabelEntry labels[],
+                                int label_count) {
+  char buf[256];
+  snprintf(buf, sizeof(buf), "%s", line);
+  char *hash = strchr(buf, '#');
+  if (hash)
+    *hash = '\0';
+
+  char out[256];
+  int changed = 0;
+  char *save = NULL;
+  char *tok = strtok_r(buf, " ,\t", &save);
+  size_t n = snprintf(out, sizeof(out), "%s", tok);
+  const char *sep = " ";
+
+  for (tok = strtok_r(NULL, " ,\t", &save); tok;
+       tok = strtok_r(NULL, " ,\t", &save), sep = ", ") {
+    char name[64];
+    const char *paren = strchr(tok, '(');
+    size_t len = paren ? (size_t)(paren - tok) : strlen(tok);
+    snprintf(name, sizeof(name), "%.*s", (int)len, tok);
+
+    const LabelEntry *label =
+        len ? find_label(name, labels, label_count) : NULL;
+    if (label && label->is_data) {
+      n += snprintf(out + n, sizeof(out) - n, "%s%d%s", sep, label->address,
+                    paren ? paren : "");
+      changed = 1;
+    } else {
+      n += snprintf(out + n, sizeof(out) - n, "%s%s", sep, tok);
+    }
+    if (n >= sizeof(out))
+      return; // too long to rewrite; leave it to the parser
+  }
+
+  if (changed)
+    snprintf(line, size, "%s", out);
+}
+
 int build_imem(const char *filename, InstMem *im, LabelEntry labels[],
                int label_count) {
   FILE *file = fopen(filename, "r");
@@ -51,6 +517,9 @@ int build_imem(const char *filename, InstMem *im, LabelEntry labels[],
 
   im->lines = calloc(MAX_IMEM, sizeof(char *));
   im->size = 0;
+  memset(&im->data, 0, sizeof(im->data));
+  strength_reduced = 0;
+  AsmState st = {.in_data = 0, .loc = 0, .path = filename};
 
   char line_raw[256];
   int pc = 0; // instruction index
@@ -88,6 +557,34 @@ int build_imem(const char *filename, InstMem *im, LabelEntry labels[],
       strcpy(line, instr);
     }
 
+    // Directives build the data image instead of instructions
+    int directive = asm_directive(line, &st, &im->data, labels, label_count);
+    if (directive < 0) {
+      fclose(file);
+      return -1;
+    }
+    if (directive)
+      continue;
+    if (st.in_data) {
+      printf("ERROR: Instruction in a .data section: %s\n", line);
+      fclose(file);
+      return -1;
+    }
+
+    // Pseudo-instructions expand to one or more real ones
+    char expanded[ASM_PSEUDO_MAX][64];
+    int pseudo = asm_pseudo(line, expanded, labels, label_count);
+    if (pseudo < 0) {
+      fclose(file);
+      return -1;
+    }
+    for (int i = 0; i < pseudo; i++) {
+      im->lines[im->size++] = strdup(expanded[i]);
+      pc++;
+    }
+    if (pseudo)
+      continue;
+
     // Now `line` should contain a pure instruction
     // Need to check if BEQ has label operand
     char clean[256];
@@ -140,19 +637,27 @@ int build_imem(const char *filename, InstMem *im, LabelEntry labels[],
       continue;
     }
 
-    // Normal instruction — store as-is
+    // Normal instruction — store as-is, with .data labels as addresses
+    resolve_data_labels(line, sizeof(line), labels, label_count);
     im->lines[im->size++] = strdup(line);
     pc++;
   }
 
   fclose(file);
-  return 0;
+
+  strength_reduce(im);
+  if (strength_reduced)
+    printf("Strength-reduced %d MUL/DIV by powers of two to shifts\n",
+           strength_reduced);
+  return encode_imem(im);
 }
 
 void free_imem(InstMem *im) {
   for (size_t i = 0; i < im->size; ++i)
     free(im->lines[i]);
   free(im->lines);
+  free(im->code);
+  dmem_image_free(&im->data);
 }
 
 // ========== PIPELINE REGISTER INITIALIZATION ==========
@@ -160,21 +665,14 @@ void free_imem(InstMem *im) {
 void init_ifid(IFIDreg *r) {
   if (!r)
     return;
-  r->instr_text = NULL;
+  r->instr = 0;
   r->pc = 0;
   r->valid = 0;
 }
 
 void free_ifid(IFIDreg *r) {
-  // Only free if we strdup'd something.
-  // Usually the simulator might just point to IMEM strings or strdup them.
-  // If strdup'd in fetch, free here.
-  // For safety in this sim, let's assume fetch does strdup or we just clear
-  // pointer.
-  if (r && r->instr_text) {
-    // free(r->instr_text); // deciding not to free to avoid double-free if just
-    // ptr copy
-  }
+  // IF/ID holds the encoded word itself; nothing to release
+  (void)r;
 }
 
 void init_idex(IDEXreg *r) {
@@ -0,0 +1,56 @@
+#include "../include/mmio.h"
+
+// Words hold 24-bit RGB like SETCLR; stored colors are opaque
+static Pixel opaque(int32_t value) { return 0xFF000000u | (value & 0xFFFFFF); }
+
+int mmio_load(Framebuffer *fb, uint32_t addr, int32_t *value) {
+  if (!fb || !mmio_hit(addr))
+    return -1;
+
+  uint32_t off = addr - sim_config.mmio_base;
+  if (off < (uint32_t)(fb->width * fb->height)) {
+    Pixel p = fb_get_pixel(fb, off % fb->width, off / fb->width);
+    *value = (int32_t)(p & 0xFFFFFF);
+    return 0;
+  }
+
+  switch (off - MMIO_REGS) {
+  case MMIO_REG_COLOR:
+    *value = (int32_t)(fb->current_color & 0xFFFFFF);
+    return 0;
+  case MMIO_REG_POS:
+    *value = (int32_t)((uint32_t)fb->draw_y << 16 | (fb->draw_x & 0xFFFF));
+    return 0;
+  case MMIO_REG_SIZE:
+    *value = fb->height << 16 | fb->width;
+    return 0;
+  case MMIO_REG_FORMAT:
+    *value = fb->format;
+    return 0;
+  default:
+    return -1; // past the frame, or not a register
+  }
+}
+
+int mmio_store(Framebuffer *fb, uint32_t addr, int32_t value) {
+  if (!fb || !mmio_hit(addr))
+    return -1;
+
+  uint32_t off = addr - sim_config.mmio_base;
+  if (off < (uint32_t)(fb->width * fb->height)) {
+    fb_set_pixel(fb, off % fb->width, off / fb->width, opaque(value));
+    return 0;
+  }
+
+  switch (off - MMIO_REGS) {
+  case MMIO_REG_COLOR:
+    fb_set_color(fb, opaque(value));
+    return 0;
+  case MMIO_REG_POS:
+    fb->draw_x = value & 0xFFFF;
+    fb->draw_y = ((uint32_t)value >> 16) & 0xFFFF;
+    return 0;
+  default:
+    return -1; // past the frame, or read-only
+  }
+}
@@ -1,4 +1,8 @@
 #include "../include/parse_instruction.h"
+#include "../include/graphics.h"
+#include "../include/trig.h"
+#include "../include/vector.h"
+#include "../include/xform.h"
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -34,6 +38,7 @@ void detectLabels(const char *filename, LabelEntry label_table[],
 
   char line[256];
   int pc = 0;
+  AsmState st = {.in_data = 0, .loc = 0, .path = filename};
 
   while (fgets(line, sizeof(line), file)) {
     char original[256];
@@ -48,7 +53,8 @@ void detectLabels(const char *filename, LabelEntry label_table[],
       original[strlen(original) - 1] = '\0'; // remove ':'
 
       strcpy(label_table[*label_index].name, original);
-      label_table[*label_index].address = pc;
+      label_table[*label_index].address = st.in_data ? (int)st.loc : pc;
+      label_table[*label_index].is_data = st.in_data;
       (*label_index)++;
 
       // DO NOT increment PC for label-only line
@@ -57,39 +63,84 @@ void detectLabels(const char *filename, LabelEntry label_table[],
 
     // Case 2: instruction or label+instruction on same line
     // We must detect label prefixes: "LOOP: ADD x1, x2, x3"
+    char *body = original;
     char *colon = strchr(original, ':');
     if (colon) {
       *colon = '\0'; // split label and instruction
       trim_inplace(original);
+      body = colon + 1;
+      trim_inplace(body);
 
       // store label
       strcpy(label_table[*label_index].name, original);
-      label_table[*label_index].address = pc;
+      label_table[*label_index].address = st.in_data ? (int)st.loc : pc;
+      label_table[*label_index].is_data = st.in_data;
       (*label_index)++;
+    }
 
-      // PC increments because instruction exists after label
-      pc++;
+    // Directives only move the .data location; errors are reported by
+    // build_imem()
+    if (asm_directive(body, &st, NULL, label_table, *label_index) != 0)
       continue;
-    }
 
-    // Case 3: normal instruction
-    pc++;
+    // Case 3: instruction (PC increments), or a pseudo-op expanding to
+    // several
+    int pseudo = asm_pseudo(body, NULL, label_table, *label_index);
+    pc += pseudo > 0 ? pseudo : 1;
   }
 
   fclose(file);
 }
 
-void instruction_parser(IFIDreg *ifid, DecodedInst *out) {
+// Bitwise/shift mnemonic: register form, or with imm set the immediate
+// form (name + "I"); OP_INVALID if token is neither
+static Opcode bitwise_op(const char *token, int imm) {
+  static const struct {
+    const char *name;
+    Opcode reg, imm;
+  } ops[] = {{"AND", OP_AND, OP_ANDI}, {"OR", OP_OR, OP_ORI},
+             {"XOR", OP_XOR, OP_XORI}, {"SLL", OP_SLL, OP_SLLI},
+             {"SRL", OP_SRL, OP_SRLI}, {"SRA", OP_SRA, OP_SRAI}};
+
+  size_t len = strlen(token);
+  if (imm) {
+    if (len < 2 || token[len - 1] != 'I')
+      return OP_INVALID;
+    len--;
+  }
+  for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+    if (strlen(ops[i].name) == len && strncmp(token, ops[i].name, len) == 0)
+      return imm ? ops[i].imm : ops[i].reg;
+  }
+  return OP_INVALID;
+}
+
+// Compare/select mnemonic (all rd, rs1, rs2); OP_INVALID if token is none
+static Opcode select_op(const char *token) {
+  static const struct {
+    const char *name;
+    Opcode op;
+  } ops[] = {{"SLT", OP_SLT}, {"SEQ", OP_SEQ}, {"CMOV", OP_CMOV},
+             {"SEL", OP_SEL}, {"MIN", OP_MIN}, {"MAX", OP_MAX}};
+
+  for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+    if (strcmp(token, ops[i].name) == 0)
+      return ops[i].op;
+  }
+  return OP_INVALID;
+}
+
+void instruction_parser(const char *text, uint32_t pc, DecodedInst *out) {
   memset(out, 0, sizeof(DecodedInst));
-  out->pc = ifid->pc;
+  out->pc = pc;
   out->valid = 0;
 
-  if (!ifid->valid || !ifid->instr_text) {
+  if (!text) {
     return;
   }
 
   char buffer[256];
-  strncpy(buffer, ifid->instr_text, sizeof(buffer));
+  strncpy(buffer, text, sizeof(buffer));
   buffer[sizeof(buffer) - 1] = '\0';
   trim_inplace(buffer);
 
@@ -151,6 +202,68 @@ void instruction_parser(IFIDreg *ifid, DecodedInst *out) {
       return;
     }
 
+    else if (bitwise_op(token, 1) != OP_INVALID) {
+      /* ANDI/ORI/XORI rd, rs1, imm  (imm sign-extended from 15 bits)
+       * SLLI/SRLI/SRAI rd, rs1, shamt */
+      char *rd = strtok_r(NULL, delimiters, &saveptr);
+      char *rs1 = strtok_r(NULL, delimiters, &saveptr);
+      char *imm = strtok_r(NULL, delimiters, &saveptr);
+
+      out->rd = rd ? parse_register(rd) : -1;
+      out->rs1 = rs1 ? parse_register(rs1) : -1;
+      out->rs2 = -1;
+      out->op = bitwise_op(token, 1);
+      out->imm = parse_immediate(imm);
+      out->valid = (out->rd >= 0 && out->rs1 >= 0 && imm != NULL);
+      return;
+    }
+
+    else if (bitwise_op(token, 0) != OP_INVALID) {
+      /* AND/OR/XOR/SLL/SRL/SRA rd, rs1, rs2 */
+      char *rd = strtok_r(NULL, delimiters, &saveptr);
+      char *rs1 = strtok_r(NULL, delimiters, &saveptr);
+      char *rs2 = strtok_r(NULL, delimiters, &saveptr);
+
+      out->rd = rd ? parse_register(rd) : -1;
+      out->rs1 = rs1 ? parse_register(rs1) : -1;
+      out->rs2 = rs2 ? parse_register(rs2) : -1;
+      out->op = bitwise_op(token, 0);
+      out->imm = 0;
+      out->valid = (out->rd >= 0 && out->rs1 >= 0 && out->rs2 >= 0);
+      return;
+    }
+
+    else if (select_op(token) != OP_INVALID) {
+      /* SLT/SEQ/MIN/MAX rd, rs1, rs2
+       * CMOV rd, rs1, rs2  -> rd = rs1 if rs2 != 0
+       * SEL rd, rs1, rs2   -> rd = rd != 0 ? rs1 : rs2 */
+      char *rd = strtok_r(NULL, delimiters, &saveptr);
+      char *rs1 = strtok_r(NULL, delimiters, &saveptr);
+      char *rs2 = strtok_r(NULL, delimiters, &saveptr);
+
+      out->rd = rd ? parse_register(rd) : -1;
+      out->rs1 = rs1 ? parse_register(rs1) : -1;
+      out->rs2 = rs2 ? parse_register(rs2) : -1;
+      out->op = select_op(token);
+      out->imm = 0;
+      out->valid = (out->rd >= 0 && out->rs1 >= 0 && out->rs2 >= 0);
+      return;
+    }
+
+    else if (strcmp(token, "LUI") == 0) {
+      /* LUI rd, imm20  -> rd = imm20 << 12 */
+      char *rd = strtok_r(NULL, delimiters, &saveptr);
+      char *imm = strtok_r(NULL, delimiters, &saveptr);
+
+      out->rd = rd ? parse_register(rd) : -1;
+      out->rs1 = -1;
+      out->rs2 = -1;
+      out->op = OP_LUI;
+      out->imm = parse_immediate(imm);
+      out->valid = (out->rd >= 0 && imm != NULL);
+      return;
+    }
+
     else if (strcmp(token, "MUL") == 0) {
       char *rd = strtok_r(NULL, delimiters, &saveptr);
       char *rs1 = strtok_r(NULL, delimiters, &saveptr);
@@ -166,6 +279,77 @@ void instruction_parser(IFIDreg *ifid, DecodedInst *out) {
       return;
     }
 
+    else if (strcmp(token, "MAC") == 0) {
+      /* MAC rd, rs1, rs2  -> rd += rs1 * rs2 */
+      char *rd = strtok_r(NULL, delimiters, &saveptr);
+      char *rs1 = strtok_r(NULL, delimiters, &saveptr);
+      char *rs2 = strtok_r(NULL, delimiters, &saveptr);
+
+      out->rd = rd ? parse_register(rd) : -1;
+      out->rs1 = rs1 ? parse_register(rs1) : -1;
+      out->rs2 = rs2 ? parse_register(rs2) : -1;
+      out->op = OP_MAC;
+      out->imm = 0;
+      out->valid = (out->rd >= 0 && out->rs1 >= 0 && out->rs2 >= 0);
+      return;
+    }
+
+    else if (strcmp(token, "DOT") == 0) {
+      /* DOT rd, rs1, rs2, n  -> rd = sum of x[rs1+i] * x[rs2+i], i < n
+       * n = 2 or 3: rs1 and rs2 name register pairs or triples */
+      char *rd = strtok_r(NULL, delimiters, &saveptr);
+      char *rs1 = strtok_r(NULL, delimiters, &saveptr);
+      char *rs2 = strtok_r(NULL, delimiters, &saveptr);
+      char *n = strtok_r(NULL, delimiters, &saveptr);
+
+      out->rd = rd ? parse_register(rd) : -1;
+      out->rs1 = rs1 ? parse_register(rs1) : -1;
+      out->rs2 = rs2 ? parse_register(rs2) : -1;
+      out->op = OP_DOT;
+      out->imm = n ? parse_immediate(n) : 0;
+      out->valid = (out->rd >= 0 && out->rs1 >= 0 && out->rs2 >= 0 &&
+                    out->imm >= 2 && out->imm <= DOT_MAX &&
+                    out->rs1 + out->imm <= 32 && out->rs2 + out->imm <= 32);
+      return;
+    }
+
+    else if (strcmp(token, "MLOAD") == 0) {
+      /* MLOAD mN, rs1  -> matrix N <- 16 words at rs1 */
+      char *m = strtok_r(NULL, delimiters, &saveptr);
+      char *rs1 = strtok_r(NULL, delimiters, &saveptr);
+
+      out->rd = -1;
+      out->rs1 = rs1 ? parse_register(rs1) : -1;
+      out->rs2 = -1;
+      out->op = OP_MLOAD;
+      out->imm = parse_mregister(m);
+      out->valid = (out->rs1 >= 0 && out->imm >= 0);
+      return;
+    }
+
+    else if (strcmp(token, "XFORM") == 0) {
+      /* XFORM rd, rs1, mN [, mode]  -> rd..rd+3 <- mN * vec4 at rs1..rs1+3
+       * mode: XFORM_PERSP divides by w, XFORM_MEM reads the vec4 from data
+       * memory at address rs1 */
+      char *rd = strtok_r(NULL, delimiters, &saveptr);
+      char *rs1 = strtok_r(NULL, delimiters, &saveptr);
+      char *m = strtok_r(NULL, delimiters, &saveptr);
+      char *mode = strtok_r(NULL, delimiters, &saveptr);
+
+      int mreg = parse_mregister(m);
+      int32_t flags = mode ? parse_immediate(mode) : 0;
+      out->rd = rd ? parse_register(rd) : -1;
+      out->rs1 = rs1 ? parse_register(rs1) : -1;
+      out->rs2 = -1;
+      out->op = OP_XFORM;
+      out->imm = mreg | flags << XFORM_MODE_SHIFT;
+      out->valid = (out->rd >= 0 && out->rs1 >= 0 && mreg >= 0 &&
+                    flags >= 0 && flags <= (XFORM_PERSP | XFORM_MEM) &&
+                    out->rd + XFORM_LANES <= 32 &&
+                    ((flags & XFORM_MEM) || out->rs1 + XFORM_LANES <= 32));
+      return;
+    }
+
     else if (strcmp(token, "DIV") == 0) {
       char *rd = strtok_r(NULL, delimiters, &saveptr);
       char *rs1 = strtok_r(NULL, delimiters, &saveptr);
@@ -181,16 +365,18 @@ void instruction_parser(IFIDreg *ifid, DecodedInst *out) {
     }
 
     else if (strcmp(token, "SIN") == 0 || strcmp(token, "COS") == 0) {
-      /* SIN rd, rs1 */
+      /* SIN rd, rs1 [, mode]  (mode: 0 degrees x100, 1 Q15, 2 Q16 CORDIC) */
       char *rd = strtok_r(NULL, delimiters, &saveptr);
       char *rs1 = strtok_r(NULL, delimiters, &saveptr);
+      char *mode = strtok_r(NULL, delimiters, &saveptr);
 
-      out->rd = parse_register(rd);
-      out->rs1 = parse_register(rs1);
+      out->rd = rd ? parse_register(rd) : -1;
+      out->rs1 = rs1 ? parse_register(rs1) : -1;
       out->rs2 = -1;
       out->op = (strcmp(token, "SIN") == 0) ? OP_SIN : OP_COS;
-      out->imm = 0;
-      out->valid = (out->rd >= 0 && out->rs1 >= 0);
+      out->imm = parse_immediate(mode);
+      out->valid = (out->rd >= 0 && out->rs1 >= 0 &&
+                    out->imm >= TRIG_LEGACY && out->imm <= TRIG_CORDIC);
       return;
     }
 
@@ -277,6 +463,287 @@ void instruction_parser(IFIDreg *ifid, DecodedInst *out) {
       return;
     }
 
+    if (strcmp(token, "COREID") == 0) {
+      /* COREID rd [, 1]  -> core index, or core count with selector 1 */
+      char *rd = strtok_r(NULL, delimiters, &saveptr);
+      char *sel = strtok_r(NULL, delimiters, &saveptr);
+
+      out->rd = rd ? parse_register(rd) : -1;
+      out->rs1 = -1;
+      out->rs2 = -1;
+      out->op = OP_COREID;
+      out->imm = parse_immediate(sel);
+      out->valid = (out->rd >= 0);
+      return;
+    }
+
+    if (strcmp(token, "GFXSYNC") == 0) {
+      /* GFXSYNC has no operands: wait for queued graphics to finish */
+      out->op = OP_GFXSYNC;
+      out->valid = 1;
+      return;
+    }
+
+    if (strcmp(token, "PRESENT") == 0) {
+      /* PRESENT has no operands: publish the back buffer as a frame */
+      out->op = OP_PRESENT;
+      out->valid = 1;
+      return;
+    }
+
+    if (strcmp(token, "SETBLEND") == 0) {
+      /* SETBLEND mode [, alpha]  -> mode by name or number, alpha 0..255
+       * (default 255); packed as alpha << 2 | mode into the immediate */
+      char *mode = strtok_r(NULL, delimiters, &saveptr);
+      char *alpha = strtok_r(NULL, delimiters, &saveptr);
+      int m = mode ? fb_blend_from_name(mode) : -1;
+      if (m < 0 && mode && isdigit((unsigned char)mode[0]))
+        m = parse_immediate(mode);
+      int a = alpha ? parse_immediate(alpha) : 255;
+
+      out->op = OP_SETBLEND;
+      out->rd = -1;
+      out->rs1 = -1;
+      out->rs2 = -1;
+      out->imm = (a & 0xFF) << 2 | (m & 3);
+      out->valid = (m >= 0 && m < FB_BLEND_COUNT && a >= 0 && a <= 255);
+      return;
+    }
+
+    if (strcmp(token, "SETTEX") == 0) {
+      /* SETTEX rs_addr, rs_size [, filter]  -> bind (h << 16 | w) words at
+       * data memory address rs_addr; filter by name or number */
+      char *raddr = strtok_r(NULL, delimiters, &saveptr);
+      char *rsize = strtok_r(NULL, delimiters, &saveptr);
+      char *filter = strtok_r(NULL, delimiters, &saveptr);
+      int f = filter ? fb_tex_filter_from_name(filter) : FB_TEX_NEAREST;
+      if (f < 0 && filter && isdigit((unsigned char)filter[0]))
+        f = parse_immediate(filter);
+
+      out->rs1 = raddr ? parse_register(raddr) : -1;
+      out->rs2 = rsize ? parse_register(rsize) : -1;
+      out->rd = -1;
+      out->op = OP_SETTEX;
+      out->imm = f;
+      out->valid = (out->rs1 >= 0 && out->rs2 >= 0 && f >= 0 &&
+                    f < FB_TEX_FILTER_COUNT);
+      return;
+    }
+
+    if (strcmp(token, "TEXU") == 0 || strcmp(token, "TEXV") == 0) {
+      /* TEXU rs_c0, rs_dx, rs_dy  -> u = c0 + x * dx + y * dy; dy in rd */
+      Opcode op = token[3] == 'U' ? OP_TEXU : OP_TEXV;
+      char *rc0 = strtok_r(NULL, delimiters, &saveptr);
+      char *rdx = strtok_r(NULL, delimiters, &saveptr);
+      char *rdy = strtok_r(NULL, delimiters, &saveptr);
+
+      out->rs1 = rc0 ? parse_register(rc0) : -1;
+      out->rs2 = rdx ? parse_register(rdx) : -1;
+      out->rd = rdy ? parse_register(rdy) : -1;
+      out->op = op;
+      out->imm = 0;
+      out->valid = (out->rs1 >= 0 && out->rs2 >= 0 && out->rd >= 0);
+      return;
+    }
+
+    if (strcmp(token, "TEX") == 0) {
+      /* TEX rd, rs_u, rs_v  -> texel at (u, v), FB_TEX_FRAC fraction bits */
+      char *rd = strtok_r(NULL, delimiters, &saveptr);
+      char *ru = strtok_r(NULL, delimiters, &saveptr);
+      char *rv = strtok_r(NULL, delimiters, &saveptr);
+
+      out->rd = rd ? parse_register(rd) : -1;
+      out->rs1 = ru ? parse_register(ru) : -1;
+      out->rs2 = rv ? parse_register(rv) : -1;
+      out->op = OP_TEX;
+      out->imm = 0;
+      out->valid = (out->rd >= 0 && out->rs1 >= 0 && out->rs2 >= 0);
+      return;
+    }
+
+    if (strcmp(token, "BLIT") == 0) {
+      /* BLIT rs_src, rs_pos, rs_size [, key]  -> copy (h << 16 | w) words
+       * from data memory to packed (y << 16 | x); size travels in rd */
+      char *rsrc = strtok_r(NULL, delimiters, &saveptr);
+      char *rpos = strtok_r(NULL, delimiters, &saveptr);
+      char *rsize = strtok_r(NULL, delimiters, &saveptr);
+      char *key = strtok_r(NULL, delimiters, &saveptr);
+
+      out->rs1 = rsrc ? parse_register(rsrc) : -1;
+      out->rs2 = rpos ? parse_register(rpos) : -1;
+      out->rd = rsize ? parse_register(rsize) : -1;
+      out->op = OP_BLIT;
+      out->imm = parse_immediate(key) != 0;
+      out->valid = (out->rs1 >= 0 && out->rs2 >= 0 && out->rd >= 0);
+      return;
+    }
+
+    if (strcmp(token, "DMAWAIT") == 0) {
+      /* DMAWAIT has no operands: wait for the last BLIT to complete */
+      out->op = OP_DMAWAIT;
+      out->valid = 1;
+      return;
+    }
+
+    if (strcmp(token, "DMAPOLL") == 0) {
+      /* DMAPOLL rd  -> 1 once every BLIT has completed, else 0 */
+      char *rd = strtok_r(NULL, delimiters, &saveptr);
+
+      out->rd = parse_register(rd);
+      out->rs1 = -1;
+      out->rs2 = -1;
+      out->op = OP_DMAPOLL;
+      out->imm = 0;
+      out->valid = (out->rd >= 0);
+      return;
+    }
+
+    if (strcmp(token, "HLINE") == 0) {
+      /* HLINE rs_x0, rs_x1, rs_y  -> y travels in the rd field */
+      char *rx0 = strtok_r(NULL, delimiters, &saveptr);
+      char *rx1 = strtok_r(NULL, delimiters, &saveptr);
+      char *ry = strtok_r(NULL, delimiters, &saveptr);
+
+      out->rs1 = rx0 ? parse_register(rx0) : -1;
+      out->rs2 = rx1 ? parse_register(rx1) : -1;
+      out->rd = ry ? parse_register(ry) : -1;
+      out->op = OP_HLINE;
+      out->imm = 0;
+      out->valid = (out->rs1 >= 0 && out->rs2 >= 0 && out->rd >= 0);
+      return;
+    }
+
+    if (strcmp(token, "FILLRECT") == 0) {
+      /* FILLRECT rs_x, rs_y  -> rectangle from the pen to (x, y) */
+      char *rx = strtok_r(NULL, delimiters, &saveptr);
+      char *ry = strtok_r(NULL, delimiters, &saveptr);
+
+      out->rs1 = rx ? parse_register(rx) : -1;
+      out->rs2 = ry ? parse_register(ry) : -1;
+      out->op = OP_FILLRECT;
+      out->rd = -1;
+      out->imm = 0;
+      out->valid = (out->rs1 >= 0 && out->rs2 >= 0);
+      return;
+    }
+
+    if (strcmp(token, "TRI") == 0) {
+      /* TRI rs_a, rs_b, rs_c  -> packed (y << 16 | x) vertices; c in rd */
+      char *ra = strtok_r(NULL, delimiters, &saveptr);
+      char *rb = strtok_r(NULL, delimiters, &saveptr);
+      char *rc = strtok_r(NULL, delimiters, &saveptr);
+
+      out->rs1 = ra ? parse_register(ra) : -1;
+      out->rs2 = rb ? parse_register(rb) : -1;
+      out->rd = rc ? parse_register(rc) : -1;
+      out->op = OP_TRI;
+      out->imm = 0;
+      out->valid = (out->rs1 >= 0 && out->rs2 >= 0 && out->rd >= 0);
+      return;
+    }
+
+    if (strcmp(token, "SETZ") == 0) {
+      /* SETZ rs1 [, 0]  -> depth for following draws; 0 turns testing off */
+      char *rs1 = strtok_r(NULL, delimiters, &saveptr);
+      char *test = strtok_r(NULL, delimiters, &saveptr);
+
+      out->rs1 = rs1 ? parse_register(rs1) : -1;
+      out->rs2 = -1;
+      out->rd = -1;
+      out->op = OP_SETZ;
+      out->imm = test ? parse_immediate(test) : 1;
+      out->valid = (out->rs1 >= 0);
+      return;
+    }
+
+    if (strcmp(token, "DRAWPIXZ") == 0) {
+      /* DRAWPIXZ rs_x, rs_y  -> depth-tested DRAWPIX */
+      char *rx = strtok_r(NULL, delimiters, &saveptr);
+      char *ry = strtok_r(NULL, delimiters, &saveptr);
+
+      out->rs1 = rx ? parse_register(rx) : -1;
+      out->rs2 = ry ? parse_register(ry) : -1;
+      out->op = OP_DRAWPIXZ;
+      out->rd = -1;
+      out->imm = 0;
+      out->valid = (out->rs1 >= 0 && out->rs2 >= 0);
+      return;
+    }
+
+    if (strcmp(token, "CLEARZ") == 0) {
+      /* CLEARZ has no operands: reset depth to the far plane */
+      out->op = OP_CLEARZ;
+      out->valid = 1;
+      return;
+    }
+
+    if (strcmp(token, "VSPLAT") == 0) {
+      /* VSPLAT vd, rs1 [, stride]  -> lane i = rs1 + i * stride */
+      char *vd = strtok_r(NULL, delimiters, &saveptr);
+      char *rs1 = strtok_r(NULL, delimiters, &saveptr);
+      char *stride = strtok_r(NULL, delimiters, &saveptr);
+
+      out->rd = parse_vregister(vd);
+      out->rs1 = rs1 ? parse_register(rs1) : -1;
+      out->rs2 = -1;
+      out->op = OP_VSPLAT;
+      out->imm = parse_immediate(stride);
+      out->valid = (out->rd >= 0 && out->rs1 >= 0);
+      return;
+    }
+
+    if (strcmp(token, "VADD") == 0 || strcmp(token, "VSUB") == 0 ||
+        strcmp(token, "VMUL") == 0 || strcmp(token, "VMIN") == 0) {
+      /* VADD vd, va, vb */
+      char *vd = strtok_r(NULL, delimiters, &saveptr);
+      char *va = strtok_r(NULL, delimiters, &saveptr);
+      char *vb = strtok_r(NULL, delimiters, &saveptr);
+
+      out->rd = parse_vregister(vd);
+      out->rs1 = parse_vregister(va);
+      out->rs2 = parse_vregister(vb);
+      if (strcmp(token, "VADD") == 0)
+        out->op = OP_VADD;
+      else if (strcmp(token, "VSUB") == 0)
+        out->op = OP_VSUB;
+      else if (strcmp(token, "VMUL") == 0)
+        out->op = OP_VMUL;
+      else
+        out->op = OP_VMIN;
+      out->imm = 0;
+      out->valid = (out->rd >= 0 && out->rs1 >= 0 && out->rs2 >= 0);
+      return;
+    }
+
+    if (strcmp(token, "VBLT") == 0) {
+      /* VBLT va, vb  -> mask bit i = va[i] < vb[i] */
+      char *va = strtok_r(NULL, delimiters, &saveptr);
+      char *vb = strtok_r(NULL, delimiters, &saveptr);
+
+      out->rd = -1;
+      out->rs1 = parse_vregister(va);
+      out->rs2 = parse_vregister(vb);
+      out->op = OP_VBLT;
+      out->imm = 0;
+      out->valid = (out->rs1 >= 0 && out->rs2 >= 0);
+      return;
+    }
+
+    if (strcmp(token, "VDRAWPIX") == 0) {
+      /* VDRAWPIX rs_x, rs_y [, mode]  -> pixels (x + lane, y) */
+      char *rx = strtok_r(NULL, delimiters, &saveptr);
+      char *ry = strtok_r(NULL, delimiters, &saveptr);
+      char *mode = strtok_r(NULL, delimiters, &saveptr);
+
+      out->rs1 = rx ? parse_register(rx) : -1;
+      out->rs2 = ry ? parse_register(ry) : -1;
+      out->op = OP_VDRAWPIX;
+      out->rd = -1;
+      out->imm = parse_immediate(mode);
+      out->valid = (out->rs1 >= 0 && out->rs2 >= 0);
+      return;
+    }
+
     if (strcmp(token, "LW") == 0) {
       /* LW rd, imm(rs1)  e.g., LW x5, 8(x3)  OR LW x5, 12(x31) */
       char *rd = strtok_r(NULL, delimiters, &saveptr);
@@ -398,6 +865,22 @@ int parse_register(const char *token) {
   return -1; // invalid
 }
 
+int parse_vregister(const char *token) {
+  // Accept forms like: v3, V3
+  if (!token || (token[0] != 'v' && token[0] != 'V'))
+    return -1;
+  int idx = atoi(token + 1);
+  return (idx >= 0 && idx < VREG_COUNT) ? idx : -1;
+}
+
+int parse_mregister(const char *token) {
+  // Accept forms like: m1, M1
+  if (!token || (token[0] != 'm' && token[0] != 'M'))
+    return -1;
+  int idx = atoi(token + 1);
+  return (idx >= 0 && idx < MREG_COUNT) ? idx : -1;
+}
+
 void trim_inplace(char *s) {
   if (!s)
     return;
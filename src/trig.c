@@ -0,0 +1,125 @@
+#include "../include/trig.h"
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define Q15_TABLE_BITS 12 // 4096 entries per turn
+#define Q15_TABLE_SIZE (1 << Q15_TABLE_BITS)
+#define Q15_FRAC_BITS (16 - Q15_TABLE_BITS)
+
+static int32_t legacy_sin[360]; // (int)(sin(deg) * 100), as libm gave it
+static int32_t legacy_cos[360];
+static int16_t q15_sin[Q15_TABLE_SIZE + 1]; // + 1 for interpolation
+
+// CORDIC constants: angles in 2^32 units per turn, gain in Q30
+static int64_t cordic_atan[TRIG_CORDIC_ITERATIONS];
+static int64_t cordic_gain;
+
+void trig_init(void) {
+  for (int d = 0; d < 360; d++) {
+    double rad = d * M_PI / 180.0;
+    legacy_sin[d] = (int32_t)(sin(rad) * 100);
+    legacy_cos[d] = (int32_t)(cos(rad) * 100);
+  }
+
+  for (int i = 0; i <= Q15_TABLE_SIZE; i++) {
+    double v = sin(2.0 * M_PI * i / Q15_TABLE_SIZE) * 32768.0;
+    v = v < 0 ? v - 0.5 : v + 0.5;
+    q15_sin[i] = (int16_t)(v > 32767 ? 32767 : v);
+  }
+
+  double k = 1.0;
+  for (int i = 0; i < TRIG_CORDIC_ITERATIONS; i++) {
+    cordic_atan[i] = llround(atan(ldexp(1.0, -i)) / (2.0 * M_PI) * 4294967296.0);
+    k /= sqrt(1.0 + ldexp(1.0, -2 * i));
+  }
+  cordic_gain = llround(k * (1 << 30));
+}
+
+// ========== LEGACY (DEGREES, x100) ==========
+
+// sin is odd and cos is even in libm too, so folding the sign keeps the
+// original results for |deg| < 360; larger angles reduce exactly
+static int32_t legacy(int32_t deg, int want_sin) {
+  int64_t d = deg;
+  int neg = d < 0;
+  int idx = (int)((neg ? -d : d) % 360);
+  if (!want_sin)
+    return legacy_cos[idx];
+  return neg ? -legacy_sin[idx] : legacy_sin[idx];
+}
+
+// ========== Q15 TABLE ==========
+
+static int32_t q15(uint32_t bam) {
+  uint32_t a = bam & 0xFFFF;
+  uint32_t i = a >> Q15_FRAC_BITS;
+  int32_t f = a & ((1 << Q15_FRAC_BITS) - 1);
+  int32_t v0 = q15_sin[i], v1 = q15_sin[i + 1];
+  return v0 + (((v1 - v0) * f + (1 << (Q15_FRAC_BITS - 1))) >> Q15_FRAC_BITS);
+}
+
+// ========== CORDIC ==========
+
+// Rotate the unit vector by `bam` and return cos and sin in Q16
+static void cordic(uint32_t bam, int32_t *c, int32_t *s) {
+  uint32_t a = bam << 16; // 2^32 units per turn
+
+  // CORDIC converges within +/-99 degrees: fold the left half-plane over
+  int flip = (a >= 0x40000000u && a < 0xC0000000u);
+  if (flip)
+    a += 0x80000000u;
+
+  int64_t z = (int32_t)a;
+  int64_t x = cordic_gain, y = 0;
+  for (int i = 0; i < TRIG_CORDIC_ITERATIONS; i++) {
+    int64_t xs = x >> i, ys = y >> i;
+    if (z >= 0) {
+      x -= ys;
+      y += xs;
+      z -= cordic_atan[i];
+    } else {
+      x += ys;
+      y -= xs;
+      z += cordic_atan[i];
+    }
+  }
+
+  // Q30 -> Q16, rounded
+  x = (x + (1 << 13)) >> 14;
+  y = (y + (1 << 13)) >> 14;
+  *c = (int32_t)(flip ? -x : x);
+  *s = (int32_t)(flip ? -y : y);
+}
+
+int32_t trig_sin(int32_t angle, int mode) {
+  int32_t c, s;
+  switch (mode) {
+  case TRIG_Q15:
+    return q15((uint32_t)angle);
+  case TRIG_CORDIC:
+    cordic((uint32_t)angle, &c, &s);
+    return s;
+  default:
+    return legacy(angle, 1);
+  }
+}
+
+int32_t trig_cos(int32_t angle, int mode) {
+  int32_t c, s;
+  switch (mode) {
+  case TRIG_Q15:
+    return q15((uint32_t)angle + 0x4000); // cos(a) = sin(a + 90)
+  case TRIG_CORDIC:
+    cordic((uint32_t)angle, &c, &s);
+    return c;
+  default:
+    return legacy(angle, 0);
+  }
+}
+
+uint32_t trig_latency(int mode) {
+  return mode == TRIG_CORDIC ? TRIG_CORDIC_ITERATIONS : 1;
+}
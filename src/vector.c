@@ -0,0 +1,148 @@
+#include "../include/vector.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+#endif
+
+__thread VReg vregs[VREG_COUNT];
+__thread uint32_t vmask = 0;
+
+void vec_splat(VReg *d, int32_t base, int32_t stride) {
+  for (int i = 0; i < VLEN_MAX; i++)
+    d->lane[i] = base + i * stride;
+}
+
+uint32_t vec_draw_mask(uint32_t mask, int mode, int lanes) {
+  uint32_t all = (lanes >= 32) ? 0xFFFFFFFFu : ((1u << lanes) - 1);
+  switch (mode) {
+  case VDRAW_INVERTED:
+    return ~mask & all;
+  case VDRAW_ALL:
+    return all;
+  default:
+    return mask & all;
+  }
+}
+
+#if defined(__AVX2__)
+
+// ========== AVX2: one 8-lane register per op ==========
+
+#define LOAD(r) _mm256_load_si256((const __m256i *)(r)->lane)
+#define STORE(r, v) _mm256_store_si256((__m256i *)(r)->lane, (v))
+
+void vec_add(VReg *d, const VReg *a, const VReg *b) {
+  STORE(d, _mm256_add_epi32(LOAD(a), LOAD(b)));
+}
+
+void vec_sub(VReg *d, const VReg *a, const VReg *b) {
+  STORE(d, _mm256_sub_epi32(LOAD(a), LOAD(b)));
+}
+
+void vec_mul(VReg *d, const VReg *a, const VReg *b) {
+  STORE(d, _mm256_mullo_epi32(LOAD(a), LOAD(b)));
+}
+
+void vec_min(VReg *d, const VReg *a, const VReg *b) {
+  STORE(d, _mm256_min_epi32(LOAD(a), LOAD(b)));
+}
+
+uint32_t vec_lt_mask(const VReg *a, const VReg *b) {
+  __m256i lt = _mm256_cmpgt_epi32(LOAD(b), LOAD(a));
+  return (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(lt));
+}
+
+#elif defined(__SSE2__)
+
+// ========== SSE2 / SSE4.1: two 4-lane halves per op ==========
+
+#define LOAD(r, h) _mm_load_si128((const __m128i *)&(r)->lane[4 * (h)])
+#define STORE(r, h, v) _mm_store_si128((__m128i *)&(r)->lane[4 * (h)], (v))
+
+static inline __m128i mullo_epi32(__m128i a, __m128i b) {
+#ifdef __SSE4_1__
+  return _mm_mullo_epi32(a, b);
+#else
+  // Multiply even and odd lanes as 64-bit products, keep the low halves
+  __m128i even = _mm_mul_epu32(a, b);
+  __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+  return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                            _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+#endif
+}
+
+static inline __m128i min_epi32(__m128i a, __m128i b) {
+#ifdef __SSE4_1__
+  return _mm_min_epi32(a, b);
+#else
+  __m128i lt = _mm_cmplt_epi32(a, b);
+  return _mm_or_si128(_mm_and_si128(lt, a), _mm_andnot_si128(lt, b));
+#endif
+}
+
+void vec_add(VReg *d, const VReg *a, const VReg *b) {
+  for (int h = 0; h < 2; h++)
+    STORE(d, h, _mm_add_epi32(LOAD(a, h), LOAD(b, h)));
+}
+
+void vec_sub(VReg *d, const VReg *a, const VReg *b) {
+  for (int h = 0; h < 2; h++)
+    STORE(d, h, _mm_sub_epi32(LOAD(a, h), LOAD(b, h)));
+}
+
+void vec_mul(VReg *d, const VReg *a, const VReg *b) {
+  for (int h = 0; h < 2; h++)
+    STORE(d, h, mullo_epi32(LOAD(a, h), LOAD(b, h)));
+}
+
+void vec_min(VReg *d, const VReg *a, const VReg *b) {
+  for (int h = 0; h < 2; h++)
+    STORE(d, h, min_epi32(LOAD(a, h), LOAD(b, h)));
+}
+
+uint32_t vec_lt_mask(const VReg *a, const VReg *b) {
+  uint32_t mask = 0;
+  for (int h = 0; h < 2; h++) {
+    __m128i lt = _mm_cmplt_epi32(LOAD(a, h), LOAD(b, h));
+    mask |= (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(lt)) << (4 * h);
+  }
+  return mask;
+}
+
+#else
+
+// ========== Portable fallback ==========
+
+void vec_add(VReg *d, const VReg *a, const VReg *b) {
+  for (int i = 0; i < VLEN_MAX; i++)
+    d->lane[i] = (int32_t)((uint32_t)a->lane[i] + (uint32_t)b->lane[i]);
+}
+
+void vec_sub(VReg *d, const VReg *a, const VReg *b) {
+  for (int i = 0; i < VLEN_MAX; i++)
+    d->lane[i] = (int32_t)((uint32_t)a->lane[i] - (uint32_t)b->lane[i]);
+}
+
+void vec_mul(VReg *d, const VReg *a, const VReg *b) {
+  for (int i = 0; i < VLEN_MAX; i++)
+    d->lane[i] = (int32_t)((uint32_t)a->lane[i] * (uint32_t)b->lane[i]);
+}
+
+void vec_min(VReg *d, const VReg *a, const VReg *b) {
+  for (int i = 0; i < VLEN_MAX; i++)
+    d->lane[i] = a->lane[i] < b->lane[i] ? a->lane[i] : b->lane[i];
+}
+
+uint32_t vec_lt_mask(const VReg *a, const VReg *b) {
+  uint32_t mask = 0;
+  for (int i = 0; i < VLEN_MAX; i++)
+    mask |= (uint32_t)(a->lane[i] < b->lane[i]) << i;
+  return mask;
+}
+
+#endif
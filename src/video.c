@@ -0,0 +1,206 @@
+#include "../include/video.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const format_names[VIDEO_FORMAT_COUNT] = {
+    [VIDEO_Y4M] = "y4m", [VIDEO_RAW] = "rgb", [VIDEO_PPM] = "ppm",
+    [VIDEO_QOI] = "qoi", [VIDEO_PNG] = "png",
+};
+
+static const ImageFormat sequence_images[VIDEO_FORMAT_COUNT] = {
+    [VIDEO_PPM] = IMAGE_PPM,
+    [VIDEO_QOI] = IMAGE_QOI,
+    [VIDEO_PNG] = IMAGE_PNG,
+};
+
+int video_is_sequence(VideoFormat format) {
+  return format == VIDEO_PPM || format == VIDEO_QOI || format == VIDEO_PNG;
+}
+
+int video_format_from_name(const char *name) {
+  for (int f = 0; f < VIDEO_FORMAT_COUNT; f++) {
+    if (name && strcmp(name, format_names[f]) == 0)
+      return f;
+  }
+  return -1;
+}
+
+VideoStream *video_open(FILE *out, VideoFormat format, int width, int height,
+                        int fps) {
+  if (!out || width < 1 || height < 1 || video_is_sequence(format))
+    return NULL;
+
+  VideoStream *vs = (VideoStream *)calloc(1, sizeof(VideoStream));
+  if (!vs)
+    return NULL;
+  vs->out = out;
+  vs->format = format;
+  vs->width = width;
+  vs->height = height;
+  vs->fps = fps > 0 ? fps : 30;
+
+  if (format == VIDEO_Y4M) {
+    size_t chroma = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+    vs->yuv = (uint8_t *)malloc((size_t)width * height + 2 * chroma);
+    if (!vs->yuv) {
+      free(vs);
+      return NULL;
+    }
+    fprintf(out, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height,
+            vs->fps);
+  }
+  return vs;
+}
+
+// Normalize a sequence name into a printf format with a single %0Nd (or
+// %d) and nothing else that printf would interpret
+static char *sequence_pattern(const char *name) {
+  size_t len = strlen(name);
+  char *pattern = (char *)malloc(2 * len + 8);
+  if (!pattern)
+    return NULL;
+
+  const char *dot = strrchr(name, '.');
+  const char *slash = strrchr(name, '/');
+  if (dot && slash && dot < slash)
+    dot = NULL;
+  int numbered = 0;
+  char *o = pattern;
+  for (const char *c = name; *c; c++) {
+    if (c == dot && !numbered && !strchr(c, '%')) {
+      memcpy(o, "_%05d", 5);
+      o += 5;
+      numbered = 1;
+    }
+    if (*c != '%') {
+      *o++ = *c;
+      continue;
+    }
+    const char *d = c + 1;
+    while (isdigit((unsigned char)*d))
+      d++;
+    if (*d == 'd' && !numbered && d - c <= 3) {
+      memcpy(o, c, (size_t)(d - c) + 1);
+      o += d - c + 1;
+      c = d;
+      numbered = 1;
+    } else {
+      *o++ = '%'; // literal percent sign
+      *o++ = '%';
+    }
+  }
+  if (!numbered) {
+    memcpy(o, "_%05d", 5);
+    o += 5;
+  }
+  *o = '\0';
+  return pattern;
+}
+
+VideoStream *video_open_sequence(const char *pattern, VideoFormat format,
+                                 int width, int height) {
+  if (!pattern || width < 1 || height < 1 || !video_is_sequence(format))
+    return NULL;
+
+  VideoStream *vs = (VideoStream *)calloc(1, sizeof(VideoStream));
+  if (!vs)
+    return NULL;
+  vs->pattern = sequence_pattern(pattern);
+  if (!vs->pattern) {
+    free(vs);
+    return NULL;
+  }
+  vs->format = format;
+  vs->width = width;
+  vs->height = height;
+  return vs;
+}
+
+// BT.601 limited range, 8-bit fixed point
+static inline uint8_t rgb_y(int r, int g, int b) {
+  return (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+static inline uint8_t rgb_u(int r, int g, int b) {
+  return (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+static inline uint8_t rgb_v(int r, int g, int b) {
+  return (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+// Packed RGB -> planar 4:2:0; chroma from the average of each 2x2 block
+static void rgb_to_i420(const uint8_t *rgb, int w, int h, uint8_t *yuv) {
+  int cw = (w + 1) / 2, ch = (h + 1) / 2;
+  uint8_t *py = yuv, *pu = yuv + (size_t)w * h, *pv = pu + (size_t)cw * ch;
+
+  for (int y = 0; y < h; y++) {
+    const uint8_t *s = rgb + (size_t)y * w * 3;
+    for (int x = 0; x < w; x++, s += 3)
+      *py++ = rgb_y(s[0], s[1], s[2]);
+  }
+
+  for (int cy = 0; cy < ch; cy++) {
+    int y0 = 2 * cy, y1 = (y0 + 1 < h) ? y0 + 1 : y0;
+    for (int cx = 0; cx < cw; cx++) {
+      int x0 = 2 * cx, x1 = (x0 + 1 < w) ? x0 + 1 : x0;
+      const uint8_t *p[4] = {rgb + ((size_t)y0 * w + x0) * 3,
+                             rgb + ((size_t)y0 * w + x1) * 3,
+                             rgb + ((size_t)y1 * w + x0) * 3,
+                             rgb + ((size_t)y1 * w + x1) * 3};
+      int r = (p[0][0] + p[1][0] + p[2][0] + p[3][0] + 2) >> 2;
+      int g = (p[0][1] + p[1][1] + p[2][1] + p[3][1] + 2) >> 2;
+      int b = (p[0][2] + p[1][2] + p[2][2] + p[3][2] + 2) >> 2;
+      *pu++ = rgb_u(r, g, b);
+      *pv++ = rgb_v(r, g, b);
+    }
+  }
+}
+
+void video_frame(void *stream, const uint8_t *rgb, int width, int height) {
+  VideoStream *vs = (VideoStream *)stream;
+  if (!vs || vs->failed || width != vs->width || height != vs->height)
+    return;
+
+  if (vs->pattern) {
+    char path[4096];
+    snprintf(path, sizeof(path), vs->pattern, (int)vs->frames);
+    if (image_write(path, sequence_images[vs->format], rgb, width, height) !=
+        0) {
+      perror(path);
+      vs->failed = 1;
+      return;
+    }
+    vs->frames++;
+    return;
+  }
+
+  size_t bytes;
+  const uint8_t *data;
+  if (vs->format == VIDEO_Y4M) {
+    rgb_to_i420(rgb, width, height, vs->yuv);
+    fputs("FRAME\n", vs->out);
+    bytes = (size_t)width * height +
+            2 * (size_t)((width + 1) / 2) * ((height + 1) / 2);
+    data = vs->yuv;
+  } else {
+    bytes = (size_t)width * height * 3;
+    data = rgb;
+  }
+
+  if (fwrite(data, 1, bytes, vs->out) != bytes) {
+    perror("video stream");
+    vs->failed = 1;
+    return;
+  }
+  vs->frames++;
+}
+
+void video_close(VideoStream *vs) {
+  if (!vs)
+    return;
+  if (vs->out)
+    fflush(vs->out);
+  free(vs->pattern);
+  free(vs->yuv);
+  free(vs);
+}
@@ -0,0 +1,44 @@
+#include "../include/xform.h"
+
+__thread Mat4 mregs[MREG_COUNT];
+
+int xform_mload(DataMemory *mem, uint32_t addr, int m) {
+  const uint32_t words = XFORM_LANES * XFORM_LANES;
+  if (!dmem_block(mem, addr, words))
+    return -1;
+  for (uint32_t i = 0; i < words; i++)
+    dmem_load(mem, addr + i, &mregs[m].m[i / XFORM_LANES][i % XFORM_LANES]);
+  return 0;
+}
+
+int xform_fetch(DataMemory *mem, uint32_t addr, int32_t v[XFORM_LANES]) {
+  if (!dmem_block(mem, addr, XFORM_LANES))
+    return -1;
+  for (int i = 0; i < XFORM_LANES; i++)
+    dmem_load(mem, addr + i, &v[i]);
+  return 0;
+}
+
+void xform_apply(int32_t imm, const int32_t v[XFORM_LANES],
+                 int32_t out[XFORM_LANES]) {
+  const Mat4 *mat = &mregs[imm & XFORM_MREG_MASK];
+  for (int r = 0; r < XFORM_LANES; r++) {
+    int64_t acc = 1 << (XFORM_FRAC_BITS - 1); // round to nearest
+    for (int c = 0; c < XFORM_LANES; c++)
+      acc += (int64_t)mat->m[r][c] * v[c];
+    out[r] = (int32_t)(acc >> XFORM_FRAC_BITS);
+  }
+
+  // Points on the eye plane (w = 0) project to the origin, as a DIV by
+  // zero gives 0. The quotient is formed in 64 bits so INT32_MIN / -1
+  // wraps to INT32_MIN instead of trapping.
+  if ((imm >> XFORM_MODE_SHIFT) & XFORM_PERSP) {
+    int32_t w = out[XFORM_LANES - 1];
+    for (int i = 0; i < XFORM_LANES - 1; i++)
+      out[i] = w ? (int32_t)(uint32_t)((int64_t)out[i] / w) : 0;
+  }
+}
+
+uint32_t xform_latency(int32_t imm) {
+  return XFORM_CYCLES + (((imm >> XFORM_MODE_SHIFT) & XFORM_PERSP) ? 1 : 0);
+}